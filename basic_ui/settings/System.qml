@@ -295,6 +295,7 @@ Rectangle {
                     // TODO(zehnm) create a framebuffer device class instead of launching hard coded shell scripts from QML
                     settingsLauncher.launch("fbv -d 1 $YIO_MEDIA_DIR/splash/bye.png")
                     console.debug("now reboot")
+                    config.flush();
                     // TODO(zehnm) create a device class for system reboot instead of launching hard coded shell scripts from QML
                     settingsLauncher.launch("reboot");
                 }
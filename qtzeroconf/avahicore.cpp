@@ -22,6 +22,9 @@
    Author(s)    : Jonathan Bagg
 ---------------------------------------------------------------------------------------------------
    Avahi-core wrapper for use in embedded Linux systems (Android)
+   The avahi server and its Qt poll adapter run in a dedicated thread: mDNS packet processing, probing
+   and announcing don't block the GUI event loop. All avahi calls are executed in that thread, results
+   are emitted from it as copies of the cached services and reach the receivers over queued connections.
 ---------------------------------------------------------------------------------------------------
 **************************************************************************************************/
 //#include <avahi-qt4/qt-watch.h>	//
@@ -31,37 +34,98 @@
 #include <avahi-core/lookup.h>
 #include <avahi-common/simple-watch.h>
 #include <QCoreApplication>
+#include <QThread>
 #include "qzeroconf.h"
 
+// thread with its own event loop hosting the avahi server, its watches and timeouts
+class AvahiThread
+{
+public:
+	AvahiThread()
+	{
+		thread.setObjectName("avahi");
+		context.moveToThread(&thread);
+		thread.start();
+	}
+	~AvahiThread()
+	{
+		thread.quit();
+		thread.wait();
+	}
+
+	static AvahiThread &instance()
+	{
+		static AvahiThread avahiThread;
+		return avahiThread;
+	}
+
+	// queues the function, functions are executed in order
+	template <typename Function>
+	static void post(Function function)
+	{
+		QMetaObject::invokeMethod(&instance().context, function, Qt::QueuedConnection);
+	}
+
+	// executes the function and waits for it
+	template <typename Function>
+	static void run(Function function)
+	{
+		AvahiThread &avahiThread = instance();
+		if (QThread::currentThread() == &avahiThread.thread)
+			function();
+		else
+			QMetaObject::invokeMethod(&avahiThread.context, function, Qt::BlockingQueuedConnection);
+	}
+
+private:
+	QThread thread;
+	QObject context;
+};
+
 class QZeroConfPrivate
 {
 public:
 	QZeroConfPrivate(QZeroConf *parent)
 	{
-		qint32 error;
-
 		pub = parent;
 		group = NULL;
 		browser = NULL;
 		txt = NULL;
 		ready = 0;
 		registerWaiting = 0;
+		avahi_server_config_init(&config);
+		config.publish_workstation = 0;
+	}
+
+	// executed in the avahi thread: the poll adapter creates its watches in the calling thread
+	void init(void)
+	{
+		qint32 error;
 
 		poll = avahi_qt_poll_get();
 		if (!poll) {
 			return;
 		}
 
-		avahi_server_config_init(&config);
-		config.publish_workstation = 0;
-
 		if (!referenceCount) {
 			server = avahi_server_new(poll, &config, serverCallback, this, &error);
 		}
 		referenceCount++;
-		if (!server) {
-			return;
-		}
+	}
+
+	// the cached services are only used in the avahi thread: the receivers get a copy of the current state
+	static QZeroConfService detached(const QZeroConfService &zcs)
+	{
+		QZeroConfService copy(new QZeroConfServiceData);
+		copy->m_name = zcs->m_name;
+		copy->m_type = zcs->m_type;
+		copy->m_domain = zcs->m_domain;
+		copy->m_host = zcs->m_host;
+		copy->m_ip = zcs->m_ip;
+		copy->m_interfaceIndex = zcs->m_interfaceIndex;
+		copy->m_port = zcs->m_port;
+		copy->m_txt = zcs->m_txt;
+		return copy;
 	}
 
 	static void serverCallback(AvahiServer *, AvahiServerState state, AVAHI_GCC_UNUSED void * userdata)
@@ -140,7 +204,7 @@ public:
 					return;
 				zcs = ref->pub->services[key];
 				ref->pub->services.remove(key);
-				emit ref->pub->serviceRemoved(zcs);
+				emit ref->pub->serviceRemoved(detached(zcs));
 				break;
 			case AVAHI_BROWSER_ALL_FOR_NOW:
 			case AVAHI_BROWSER_CACHE_EXHAUSTED:
@@ -199,14 +263,14 @@ public:
 			zcs->setIp(addr);
 
 			if (newRecord)
-				emit ref->pub->serviceAdded(zcs);
+				emit ref->pub->serviceAdded(detached(zcs));
 			else
-				emit ref->pub->serviceUpdated(zcs);
+				emit ref->pub->serviceUpdated(detached(zcs));
 		}
 		else if (ref->pub->services.contains(key)) {	// delete service if exists and unable to resolve
 			zcs = ref->pub->services[key];
 			ref->pub->services.remove(key);
-			emit ref->pub->serviceRemoved(zcs);
+			emit ref->pub->serviceRemoved(detached(zcs));
 			// don't delete the resolver here...we need to keep it around so Avahi will keep updating....might be able to resolve the service in the future
 		}
 	}
@@ -220,7 +284,7 @@ public:
 
 		QMap<QString, QZeroConfService>::iterator i;
 		for (i = pub->services.begin(); i != pub->services.end(); i++) {
-			emit pub->serviceRemoved(i.value());
+			emit pub->serviceRemoved(detached(i.value()));
 		}
 		pub->services.clear();
 
@@ -277,57 +341,75 @@ QZeroConf::QZeroConf(QObject *parent) : QObject (parent)
 {
 	pri = new QZeroConfPrivate(this);
 	qRegisterMetaType<QZeroConfService>("QZeroConfService");
+
+	QZeroConfPrivate *p = pri;
+	AvahiThread::post([p]() { p->init(); });
 }
 
 QZeroConf::~QZeroConf()
 {
-	avahi_string_list_free(pri->txt);
-	pri->broswerCleanUp();
-	avahi_server_config_free(&pri->config);
-	pri->referenceCount--;
-	if (!pri->referenceCount)
-		avahi_server_free(pri->server);
+	// waits for the queued calls of this instance as well
+	QZeroConfPrivate *p = pri;
+	AvahiThread::run([p]() {
+		avahi_string_list_free(p->txt);
+		p->broswerCleanUp();
+		avahi_server_config_free(&p->config);
+		p->referenceCount--;
+		if (!p->referenceCount) {
+			avahi_server_free(p->server);
+			p->server = NULL;
+		}
+	});
 	delete pri;
 }
 
 void QZeroConf::startServicePublish(const char *name, const char *type, const char *domain, quint16 port)
 {
-	if (pri->group) {
-		emit error(QZeroConf::serviceRegistrationFailed);
-		return;
-	}
-	if (pri->ready)
-		pri->registerService(name, type, domain, port);
-	else {
-		pri->registerWaiting = 1;
-		pri->name = name;
-		pri->type = type;
-		pri->domain = domain;
-		pri->port = port;
-	}
+	QZeroConfPrivate *p = pri;
+	QByteArray n(name), t(type), d(domain);
+	AvahiThread::post([this, p, n, t, d, port]() {
+		if (p->group) {
+			emit error(QZeroConf::serviceRegistrationFailed);
+			return;
+		}
+		if (p->ready)
+			p->registerService(n, t, d, port);
+		else {
+			p->registerWaiting = 1;
+			p->name = n;
+			p->type = t;
+			p->domain = d;
+			p->port = port;
+		}
+	});
 }
 
 void QZeroConf::stopServicePublish(void)
 {
-	if (pri->group) {
-		avahi_s_entry_group_free(pri->group);
-		pri->group = NULL;
-	}
+	QZeroConfPrivate *p = pri;
+	AvahiThread::post([p]() {
+		if (p->group) {
+			avahi_s_entry_group_free(p->group);
+			p->group = NULL;
+		}
+	});
 }
 
 bool QZeroConf::publishExists(void)
 {
-	if (pri->group)
-		return true;
-	else
-		return false;
+	bool exists = false;
+	QZeroConfPrivate *p = pri;
+	AvahiThread::run([p, &exists]() { exists = p->group != NULL; });
+	return exists;
 }
 
 // http://www.zeroconf.org/rendezvous/txtrecords.html
 
 void QZeroConf::addServiceTxtRecord(QString nameOnly)
 {
-	pri->txt = avahi_string_list_add(pri->txt, nameOnly.toUtf8());
+	QZeroConfPrivate *p = pri;
+	QByteArray record = nameOnly.toUtf8();
+	AvahiThread::post([p, record]() { p->txt = avahi_string_list_add(p->txt, record); });
 }
 
 void QZeroConf::addServiceTxtRecord(QString name, QString value)
@@ -339,38 +421,46 @@ void QZeroConf::addServiceTxtRecord(QString name, QString value)
 
 void QZeroConf::clearServiceTxtRecords()
 {
-	avahi_string_list_free(pri->txt);
-	pri->txt = NULL;
+	QZeroConfPrivate *p = pri;
+	AvahiThread::post([p]() {
+		avahi_string_list_free(p->txt);
+		p->txt = NULL;
+	});
 }
 
 void QZeroConf::startBrowser(QString type, QAbstractSocket::NetworkLayerProtocol protocol)
 {
-	if (pri->browser)
-		emit error(QZeroConf::browserFailed);
-
-	switch (protocol) {
-		case QAbstractSocket::IPv4Protocol: pri->aProtocol = AVAHI_PROTO_INET; break;
-		case QAbstractSocket::IPv6Protocol: pri->aProtocol = AVAHI_PROTO_INET6; break;
-		default:
-			qDebug("QZeroConf::startBrowser() - unsupported protocol, using IPv4");
-			pri->aProtocol = AVAHI_PROTO_INET;
-			break;
-	};
-
-	pri->browser = avahi_s_service_browser_new(pri->server, AVAHI_IF_UNSPEC, pri->aProtocol, type.toUtf8(), NULL, AVAHI_LOOKUP_USE_MULTICAST, QZeroConfPrivate::browseCallback, pri);
-	if (!pri->browser)
-		emit error(QZeroConf::browserFailed);
+	QZeroConfPrivate *p = pri;
+	QByteArray browseType = type.toUtf8();
+	AvahiThread::post([this, p, browseType, protocol]() {
+		if (p->browser)
+			emit error(QZeroConf::browserFailed);
+
+		switch (protocol) {
+			case QAbstractSocket::IPv4Protocol: p->aProtocol = AVAHI_PROTO_INET; break;
+			case QAbstractSocket::IPv6Protocol: p->aProtocol = AVAHI_PROTO_INET6; break;
+			default:
+				qDebug("QZeroConf::startBrowser() - unsupported protocol, using IPv4");
+				p->aProtocol = AVAHI_PROTO_INET;
+				break;
+		};
+
+		p->browser = avahi_s_service_browser_new(p->server, AVAHI_IF_UNSPEC, p->aProtocol, browseType, NULL, AVAHI_LOOKUP_USE_MULTICAST, QZeroConfPrivate::browseCallback, p);
+		if (!p->browser)
+			emit error(QZeroConf::browserFailed);
+	});
 }
 
 void QZeroConf::stopBrowser(void)
 {
-	pri->broswerCleanUp();
+	QZeroConfPrivate *p = pri;
+	AvahiThread::post([p]() { p->broswerCleanUp(); });
 }
 
 bool QZeroConf::browserExists(void)
 {
-	if (pri->browser)
-		return true;
-	else
-		return false;
+	bool exists = false;
+	QZeroConfPrivate *p = pri;
+	AvahiThread::run([p, &exists]() { exists = p->browser != NULL; });
+	return exists;
 }
@@ -0,0 +1,8 @@
+QT+= core network
+QT-= gui
+CONFIG+= console c++11
+TARGET = mdns_benchmark
+SOURCES= main.cpp
+DEFINES= QZEROCONF_STATIC
+
+include(../qtzeroconf.pri)
@@ -0,0 +1,173 @@
+/**************************************************************************************************
+---------------------------------------------------------------------------------------------------
+	This file is part of QtZeroConf.
+
+	QtZeroConf is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Lesser General Public License as published by
+	the Free Software Foundation, either version 3 of the License, or
+	(at your option) any later version.
+
+	QtZeroConf is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public License
+	along with QtZeroConf.  If not, see <http://www.gnu.org/licenses/>.
+---------------------------------------------------------------------------------------------------
+   Project name : QtZeroConf Benchmark
+   File name    : main.cpp
+---------------------------------------------------------------------------------------------------
+   Replays a captured burst of mDNS traffic (pcap file, Ethernet / IPv4 / UDP port 5353) to the
+   mDNS multicast group while browsing for a service type, and measures the event loop latency of
+   the main thread. With the avahi server running in its own thread the main thread stays responsive
+   during the burst.
+
+   Usage: mdns_benchmark <capture.pcap> [service type, default _googlecast._tcp] [speed factor, 0 = burst]
+   Capture: tcpdump -i wlan0 -w capture.pcap udp port 5353
+---------------------------------------------------------------------------------------------------
+**************************************************************************************************/
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTimer>
+#include <QUdpSocket>
+#include <QVector>
+#include <QtEndian>
+#include <algorithm>
+#include <cstdio>
+#include "../qzeroconf.h"
+
+struct Packet
+{
+	qint64 time;		// microseconds since the first packet
+	QByteArray payload;	// UDP payload: the mDNS message
+};
+
+static bool readCapture(const QString &fileName, QVector<Packet> &packets)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+	QByteArray data = file.readAll();
+	if (data.size() < 24)
+		return false;
+
+	const uchar *header = reinterpret_cast<const uchar *>(data.constData());
+	quint32 magic = qFromLittleEndian<quint32>(header);
+	bool swapped;
+	if (magic == 0xa1b2c3d4)
+		swapped = false;
+	else if (magic == 0xd4c3b2a1)
+		swapped = true;
+	else
+		return false;
+	auto read32 = [swapped](const uchar *p) { return swapped ? qFromBigEndian<quint32>(p) : qFromLittleEndian<quint32>(p); };
+	if (read32(header + 20) != 1)	// link type Ethernet
+		return false;
+
+	qint64 first = -1;
+	int offset = 24;
+	while (offset + 16 <= data.size()) {
+		const uchar *record = reinterpret_cast<const uchar *>(data.constData()) + offset;
+		qint64 time = static_cast<qint64>(read32(record)) * 1000000 + read32(record + 4);
+		int length = static_cast<int>(read32(record + 8));
+		offset += 16;
+		if (offset + length > data.size())
+			break;
+
+		const uchar *frame = record + 16;
+		int ipOffset = 14;
+		if (length > ipOffset + 20 && qFromBigEndian<quint16>(frame + 12) == 0x0800 && frame[ipOffset + 9] == 17) {
+			int udpOffset = ipOffset + (frame[ipOffset] & 0x0f) * 4;
+			if (length > udpOffset + 8 && qFromBigEndian<quint16>(frame + udpOffset + 2) == 5353) {
+				if (first < 0)
+					first = time;
+				Packet packet;
+				packet.time = time - first;
+				packet.payload = QByteArray(reinterpret_cast<const char *>(frame + udpOffset + 8), length - udpOffset - 8);
+				packets.append(packet);
+			}
+		}
+		offset += length;
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	QStringList args = app.arguments();
+	if (args.size() < 2) {
+		qWarning("Usage: mdns_benchmark <capture.pcap> [service type] [speed factor, 0 = burst]");
+		return 1;
+	}
+
+	QVector<Packet> packets;
+	if (!readCapture(args.at(1), packets) || packets.isEmpty()) {
+		qWarning("No mDNS packets found in %s", qPrintable(args.at(1)));
+		return 1;
+	}
+	QString type = args.size() > 2 ? args.at(2) : QString("_googlecast._tcp");
+	double speed = args.size() > 3 ? args.at(3).toDouble() : 1.0;
+
+	QZeroConf zeroConf;
+	int added = 0, updated = 0, removed = 0;
+	QObject::connect(&zeroConf, &QZeroConf::serviceAdded, [&added](QZeroConfService) { added++; });
+	QObject::connect(&zeroConf, &QZeroConf::serviceUpdated, [&updated](QZeroConfService) { updated++; });
+	QObject::connect(&zeroConf, &QZeroConf::serviceRemoved, [&removed](QZeroConfService) { removed++; });
+	zeroConf.startBrowser(type);
+
+	QUdpSocket socket;
+	socket.bind(QHostAddress(QHostAddress::AnyIPv4), 0);
+	socket.setSocketOption(QAbstractSocket::MulticastLoopbackOption, 1);
+	QHostAddress group("224.0.0.251");
+
+	// event loop latency of the main thread: lateness of a 1 ms timer
+	QVector<qint64> lateness;
+	QElapsedTimer clock;
+	qint64 lastTick = 0;
+	QTimer ticker;
+	ticker.setTimerType(Qt::PreciseTimer);
+	QObject::connect(&ticker, &QTimer::timeout, [&]() {
+		qint64 now = clock.nsecsElapsed() / 1000;
+		lateness.append(qMax<qint64>(0, now - lastTick - 1000));
+		lastTick = now;
+	});
+
+	int next = 0;
+	QElapsedTimer replay;
+	QTimer sender;
+	QObject::connect(&sender, &QTimer::timeout, [&]() {
+		qint64 elapsed = replay.nsecsElapsed() / 1000;
+		while (next < packets.size() && (speed <= 0 || packets.at(next).time / speed <= elapsed)) {
+			socket.writeDatagram(packets.at(next).payload, group, 5353);
+			next++;
+		}
+		if (next == packets.size()) {
+			sender.stop();
+			// let the avahi thread process the tail of the burst
+			QTimer::singleShot(2000, &app, &QCoreApplication::quit);
+		}
+	});
+
+	// give the avahi server time to start probing before replaying
+	QTimer::singleShot(1000, [&]() {
+		clock.start();
+		replay.start();
+		ticker.start(1);
+		sender.start(0);
+	});
+
+	app.exec();
+
+	std::sort(lateness.begin(), lateness.end());
+	auto percentile = [&lateness](double p) {
+		return lateness.isEmpty() ? 0 : lateness.at(qMin(lateness.size() - 1, static_cast<int>(lateness.size() * p / 100)));
+	};
+	printf("packets replayed: %d in %lld ms\n", packets.size(), replay.elapsed());
+	printf("services: %d added, %d updated, %d removed\n", added, updated, removed);
+	printf("event loop lateness (us): p50 %lld, p99 %lld, max %lld over %d ticks\n", percentile(50), percentile(99),
+	       lateness.isEmpty() ? 0 : lateness.last(), lateness.size());
+	return 0;
+}
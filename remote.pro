@@ -91,10 +91,15 @@ isEmpty(INTG_LIB_PATH) {
 
 HEADERS += \
     components/media_player/sources/utils_mediaplayer.h \
+    sources/apiclient.h \
+    sources/apieventhub.h \
+    sources/apiserver.h \
     sources/bluetooth.h \
     sources/commandlinehandler.h \
     sources/config.h \
+    sources/configsnapshot.h \
     sources/configutil.h \
+    sources/configwriter.h \
     sources/entities/climate.h \
     sources/entities/entities_supported.h \
     sources/entities/remote.h \
@@ -103,6 +108,7 @@ HEADERS += \
     sources/environment.h \
     sources/filedownload.h \
     sources/fileio.h \
+    sources/frametimemonitor.h \
     sources/hardware/batterycharger.h \
     sources/hardware/batteryfuelgauge.h \
     sources/hardware/buttonhandler.h \
@@ -122,11 +128,18 @@ HEADERS += \
     sources/hardware/proximitysensor.h \
     sources/hardware/mock/proximitysensor_mock.h \
     sources/hardware/sysinfo.h \
+    sources/integrations/commandqueue.h \
     sources/integrations/integrations.h \
     sources/integrations/integrationsinterface.h \
+    sources/integrations/integrationthreads.h \
+    sources/integrations/pluginindex.h \
+    sources/integrations/reconnectscheduler.h \
     sources/jsonfile.h \
+    sources/jsonpatch.h \
+    sources/latencyhistogram.h \
     sources/launcher.h \
     sources/logger.h \
+    sources/networkdiscovery.h \
     sources/softwareupdate.h \
     sources/standbycontrol.h \
     sources/translation.h \
@@ -157,24 +170,36 @@ HEADERS += \
 
 SOURCES += \
     components/media_player/sources/utils_mediaplayer.cpp \
+    sources/apiclient.cpp \
+    sources/apieventhub.cpp \
+    sources/apiserver.cpp \
     sources/bluetooth.cpp \
     sources/commandlinehandler.cpp \
     sources/config.cpp \
+    sources/configsnapshot.cpp \
     sources/configutil.cpp \
+    sources/configwriter.cpp \
     sources/entities/climate.cpp \
     sources/entities/remote.cpp \
     sources/entities/switch.cpp \
     sources/entities/weather.cpp \
     sources/environment.cpp \
     sources/filedownload.cpp \
+    sources/frametimemonitor.cpp \
     sources/hardware/buttonhandler.cpp \
     sources/hardware/device.cpp \
     sources/hardware/hardwarefactory_default.cpp \
     sources/hardware/touchdetect.cpp \
+    sources/integrations/commandqueue.cpp \
     sources/integrations/integrations.cpp \
+    sources/integrations/integrationthreads.cpp \
+    sources/integrations/pluginindex.cpp \
+    sources/integrations/reconnectscheduler.cpp \
     sources/logger.cpp \
     sources/main.cpp \
     sources/jsonfile.cpp \
+    sources/jsonpatch.cpp \
+    sources/latencyhistogram.cpp \
     sources/launcher.cpp \
     sources/hardware/hardwarefactory.cpp \
     sources/hardware/systemservice.cpp \
@@ -187,6 +212,7 @@ SOURCES += \
     sources/entities/entity.cpp \
     sources/entities/light.cpp \
     sources/entities/blind.cpp \
+    sources/networkdiscovery.cpp \
     sources/notifications.cpp \
     sources/entities/mediaplayer.cpp \
     sources/softwareupdate.cpp \
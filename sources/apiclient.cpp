@@ -0,0 +1,256 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2020 Markus Zehnder <business@markuszehnder.ch>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "apiclient.h"
+
+#include <QCborMap>
+#include <QCborValue>
+#include <QJsonDocument>
+#include <QLoggingCategory>
+#include <QtDebug>
+
+#include "configutil.h"
+
+static Q_LOGGING_CATEGORY(CLASS_LC, "api.client");
+
+ApiClient::Limits ApiClient::limitsFromSettings(const QVariantMap &settings) {
+    Limits limits;
+    limits.highWatermark =
+        ConfigUtil::getValue(settings, "api/sendQueue/highWatermark", limits.highWatermark).toLongLong();
+    limits.lowWatermark =
+        ConfigUtil::getValue(settings, "api/sendQueue/lowWatermark", limits.lowWatermark).toLongLong();
+    limits.maxBytes     = ConfigUtil::getValue(settings, "api/sendQueue/maxBytes", limits.maxBytes).toLongLong();
+    limits.pingInterval = ConfigUtil::getValue(settings, "api/pingInterval", limits.pingInterval).toInt();
+
+    QString policy = ConfigUtil::getValue(settings, "api/sendQueue/policy").toString();
+    if (policy == "drop_oldest") {
+        limits.policy = OverflowPolicy::DropOldest;
+    } else if (policy == "disconnect") {
+        limits.policy = OverflowPolicy::Disconnect;
+    }
+
+    if (limits.lowWatermark > limits.highWatermark) {
+        limits.lowWatermark = limits.highWatermark;
+    }
+    return limits;
+}
+
+ApiClient::ApiClient(QWebSocket *socket, const Limits &limits, QObject *parent)
+    : QObject(parent),
+      m_socket(socket),
+      m_limits(limits),
+      m_address(socket->peerAddress().toString()),
+      m_connected(1),
+      m_authenticated(0),
+      m_encoding(static_cast<int>(Encoding::Json)),
+      m_congested(0) {
+    m_socket->setParent(this);
+    connect(m_socket, &QWebSocket::bytesWritten, this, &ApiClient::onBytesWritten);
+    connect(m_socket, &QWebSocket::pong, this, &ApiClient::onPong);
+    connect(m_socket, &QWebSocket::disconnected, this, [this]() { m_connected.storeRelease(0); });
+
+    if (m_limits.pingInterval > 0) {
+        connect(&m_pingTimer, &QTimer::timeout, this, [this]() { m_socket->ping(); });
+        m_pingTimer.start(m_limits.pingInterval);
+    }
+}
+
+QString ApiClient::toJson(const QVariantMap &message) {
+    return QString::fromUtf8(QJsonDocument::fromVariant(message).toJson(QJsonDocument::JsonFormat::Compact));
+}
+
+QByteArray ApiClient::toCbor(const QVariantMap &message) { return QCborValue::fromVariant(message).toCbor(); }
+
+void ApiClient::close(QWebSocketProtocol::CloseCode closeCode, const QString &reason) {
+    QMetaObject::invokeMethod(this, [this, closeCode, reason]() { m_socket->close(closeCode, reason); });
+}
+
+void ApiClient::send(const QVariantMap &message) {
+    // encoded in the client thread: serializing large responses doesn't block the caller. The encoding is the one at
+    // the time of the call, e.g. auth_ok is sent before switching to CBOR.
+    Encoding encoding = this->encoding();
+    QMetaObject::invokeMethod(this, [this, message, encoding]() {
+        if (encoding == Encoding::Cbor) {
+            enqueue({QString(), toCbor(message), QString(), false});
+        } else {
+            enqueue({toJson(message), QByteArray(), QString(), false});
+        }
+    });
+}
+
+void ApiClient::send(const QJsonObject &message) {
+    Encoding encoding = this->encoding();
+    QMetaObject::invokeMethod(this, [this, message, encoding]() {
+        if (encoding == Encoding::Cbor) {
+            enqueue({QString(), QCborValue(QCborMap::fromJsonObject(message)).toCbor(), QString(), false});
+        } else {
+            enqueue({QString::fromUtf8(QJsonDocument(message).toJson(QJsonDocument::JsonFormat::Compact)),
+                     QByteArray(), QString(), false});
+        }
+    });
+}
+
+void ApiClient::send(const QString &message) { post({message, QByteArray(), QString(), false}); }
+
+void ApiClient::send(const QByteArray &message) { post({QString(), message, QString(), false}); }
+
+void ApiClient::sendEvent(const QString &message, const QString &key) { post({message, QByteArray(), key, true}); }
+
+void ApiClient::sendEvent(const QByteArray &message, const QString &key) { post({QString(), message, key, true}); }
+
+QVariantMap ApiClient::statistics() const {
+    QMutexLocker locker(&m_mutex);
+
+    QVariantMap rtt;
+    rtt.insert("last", m_lastRtt);
+    rtt.insert("max", m_maxRtt);
+    rtt.insert("avg", m_pongs > 0 ? m_totalRtt / m_pongs : 0);
+
+    QVariantMap stats;
+    stats.insert("address", m_address);
+    stats.insert("authenticated", isAuthenticated());
+    stats.insert("encoding", encoding() == Encoding::Cbor ? "cbor" : "json");
+    stats.insert("sent", m_sent);
+    stats.insert("queued", m_queued);
+    stats.insert("queued_messages", m_queue.size());
+    stats.insert("queued_bytes", m_queuedBytes);
+    stats.insert("max_queued_bytes", m_maxQueuedBytes);
+    stats.insert("socket_bytes", m_socketBytes);
+    stats.insert("dropped", m_dropped);
+    stats.insert("coalesced", m_coalesced);
+    stats.insert("rtt", rtt);
+    return stats;
+}
+
+void ApiClient::post(const Message &message) {
+    // executed directly if called from the client thread, queued otherwise
+    QMetaObject::invokeMethod(this, [this, message]() { enqueue(message); });
+}
+
+void ApiClient::enqueue(const Message &message) {
+    if (!m_socket->isValid()) {
+        return;
+    }
+
+    QMutexLocker locker(&m_mutex);
+
+    if (m_queue.isEmpty() && m_socket->bytesToWrite() < m_limits.highWatermark) {
+        write(message);
+        return;
+    }
+
+    if (m_limits.policy == OverflowPolicy::Coalesce && !message.key.isEmpty() && coalesce(message)) {
+        return;
+    }
+
+    m_queue.enqueue(message);
+    m_congested.storeRelease(1);
+    m_queuedBytes += message.size();
+    m_queued++;
+    if (m_queuedBytes > m_maxQueuedBytes) {
+        m_maxQueuedBytes = m_queuedBytes;
+    }
+
+    if (m_queuedBytes <= m_limits.maxBytes) {
+        return;
+    }
+
+    if (m_limits.policy != OverflowPolicy::Disconnect) {
+        dropOldest();
+    }
+
+    // only responses left or disconnect policy: a client not reading its responses is disconnected as well
+    if (m_queuedBytes > m_limits.maxBytes) {
+        qCWarning(CLASS_LC) << "Send queue overflow, disconnecting client" << m_address
+                            << "queued bytes:" << m_queuedBytes;
+        m_dropped += m_queue.size();
+        m_queue.clear();
+        m_congested.storeRelease(0);
+        m_queuedBytes = 0;
+        m_socket->close(QWebSocketProtocol::CloseCodePolicyViolated, "Send queue overflow");
+    }
+}
+
+bool ApiClient::coalesce(const Message &message) {
+    for (Message &queued : m_queue) {
+        if (queued.key == message.key) {
+            m_queuedBytes += message.size() - queued.size();
+            queued.text   = message.text;
+            queued.binary = message.binary;
+            m_coalesced++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ApiClient::dropOldest() {
+    auto iter = m_queue.begin();
+    while (iter != m_queue.end() && m_queuedBytes > m_limits.maxBytes) {
+        if (iter->droppable) {
+            m_queuedBytes -= iter->size();
+            m_dropped++;
+            iter = m_queue.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+}
+
+void ApiClient::drain() {
+    while (!m_queue.isEmpty() && m_socket->bytesToWrite() < m_limits.highWatermark) {
+        Message message = m_queue.dequeue();
+        m_queuedBytes -= message.size();
+        write(message);
+    }
+    if (m_queue.isEmpty()) {
+        m_congested.storeRelease(0);
+    }
+}
+
+void ApiClient::write(const Message &message) {
+    if (message.binary.isEmpty()) {
+        m_socket->sendTextMessage(message.text);
+    } else {
+        m_socket->sendBinaryMessage(message.binary);
+    }
+    m_sent++;
+    m_socketBytes = m_socket->bytesToWrite();
+}
+
+void ApiClient::onBytesWritten() {
+    QMutexLocker locker(&m_mutex);
+    m_socketBytes = m_socket->bytesToWrite();
+    if (!m_queue.isEmpty() && m_socketBytes <= m_limits.lowWatermark) {
+        drain();
+    }
+}
+
+void ApiClient::onPong(quint64 elapsedTime) {
+    QMutexLocker locker(&m_mutex);
+    m_lastRtt = elapsedTime;
+    m_totalRtt += elapsedTime;
+    m_pongs++;
+    if (elapsedTime > m_maxRtt) {
+        m_maxRtt = elapsedTime;
+    }
+}
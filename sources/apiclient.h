@@ -0,0 +1,167 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2020 Markus Zehnder <business@markuszehnder.ch>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QAtomicInt>
+#include <QJsonObject>
+#include <QMutex>
+#include <QObject>
+#include <QQueue>
+#include <QTimer>
+#include <QVariantMap>
+#include <QtWebSockets/QWebSocket>
+
+/**
+ * @brief ApiClient wraps the WebSocket connection of an API client with a bounded outbound queue.
+ * Messages are passed to the socket as long as its pending bytes stay below the high watermark, otherwise they are
+ * queued and sent when the socket drained below the low watermark. If the queue exceeds its maximum size the overflow
+ * policy applies: events are coalesced or dropped, or the client is disconnected.
+ * The round trip time is measured with WebSocket pings.
+ * Messages are encoded as JSON text frames or, once negotiated by the client, as binary CBOR frames.
+ * The client lives in the API server thread together with its socket. The public methods may be called from any
+ * thread: messages are encoded and written in the client thread.
+ */
+class ApiClient : public QObject {
+    Q_OBJECT
+
+ public:
+    enum class OverflowPolicy {
+        Coalesce,    // events with the same key replace each other, then the oldest events are dropped
+        DropOldest,  // the oldest events are dropped
+        Disconnect   // the client is disconnected
+    };
+
+    enum class Encoding { Json, Cbor };
+
+    struct Limits {
+        qint64         highWatermark = 65536;
+        qint64         lowWatermark  = 16384;
+        qint64         maxBytes      = 262144;  // maximum size of the queued messages
+        OverflowPolicy policy        = OverflowPolicy::Coalesce;
+        int            pingInterval  = 30000;  // milliseconds, 0 disables pings
+    };
+
+    /**
+     * @brief Reads the limits from the "api" section of the settings.
+     */
+    static Limits limitsFromSettings(const QVariantMap& settings);
+
+    /**
+     * @brief Takes ownership of the socket.
+     */
+    ApiClient(QWebSocket* socket, const Limits& limits, QObject* parent = nullptr);
+
+    QWebSocket* socket() const { return m_socket; }
+    bool        isValid() const { return m_connected.loadAcquire() != 0; }
+
+    bool isAuthenticated() const { return m_authenticated.loadAcquire() != 0; }
+    void setAuthenticated(bool authenticated) { m_authenticated.storeRelease(authenticated ? 1 : 0); }
+
+    Encoding encoding() const { return static_cast<Encoding>(m_encoding.loadAcquire()); }
+    void     setEncoding(Encoding encoding) { m_encoding.storeRelease(static_cast<int>(encoding)); }
+
+    /**
+     * @brief Closes the connection after the already sent messages.
+     */
+    void close(QWebSocketProtocol::CloseCode closeCode = QWebSocketProtocol::CloseCodeNormal,
+               const QString&                reason    = QString());
+
+    static QString    toJson(const QVariantMap& message);
+    static QByteArray toCbor(const QVariantMap& message);
+
+    /**
+     * @brief Encodes and sends a message which must not be dropped, e.g. a request response.
+     */
+    void send(const QVariantMap& message);
+    void send(const QJsonObject& message);
+
+    /**
+     * @brief Sends an already encoded message as text (JSON) or binary (CBOR) frame. The message is never dropped.
+     */
+    void send(const QString& message);
+    void send(const QByteArray& message);
+
+    /**
+     * @brief Sends an event which may be coalesced or dropped if the client cannot keep up.
+     * @param key Queued events with the same key are superseded by the new event with the coalesce policy. Events
+     * without key are never coalesced.
+     */
+    void sendEvent(const QString& message, const QString& key = QString());
+    void sendEvent(const QByteArray& message, const QString& key = QString());
+
+    /**
+     * @brief Returns true if messages are waiting in the queue: the client doesn't keep up with the sent data.
+     */
+    bool isCongested() const { return m_congested.loadAcquire() != 0; }
+
+    /**
+     * @brief Returns the queue and round trip time statistics of the client.
+     */
+    QVariantMap statistics() const;
+
+ private:
+    struct Message {
+        QString    text;
+        QByteArray binary;  // sent as binary frame if not empty
+        QString    key;
+        bool       droppable;
+
+        // the UTF-16 length is a sufficient estimate of the mostly ASCII JSON messages
+        qint64 size() const { return binary.isEmpty() ? text.size() : binary.size(); }
+    };
+
+    void post(const Message& message);
+    void enqueue(const Message& message);
+    bool coalesce(const Message& message);
+    void dropOldest();
+    void drain();
+    void write(const Message& message);
+
+    void onBytesWritten();
+    void onPong(quint64 elapsedTime);
+
+    QWebSocket* m_socket;
+    Limits      m_limits;
+    QString     m_address;
+    QAtomicInt  m_connected;
+    QAtomicInt  m_authenticated;
+    QAtomicInt  m_encoding;
+    QAtomicInt  m_congested;
+
+    // guards the queue and the statistics, which are read from other threads
+    mutable QMutex  m_mutex;
+    QQueue<Message> m_queue;
+    qint64          m_queuedBytes = 0;
+    QTimer          m_pingTimer;
+
+    quint32 m_sent           = 0;
+    quint32 m_queued         = 0;
+    quint32 m_dropped        = 0;
+    quint32 m_coalesced      = 0;
+    qint64  m_maxQueuedBytes = 0;
+    quint64 m_lastRtt        = 0;
+    quint64 m_maxRtt         = 0;
+    quint64 m_totalRtt       = 0;
+    quint32 m_pongs          = 0;
+    qint64  m_socketBytes    = 0;
+};
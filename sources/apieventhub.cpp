@@ -0,0 +1,571 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2020 Markus Zehnder <business@markuszehnder.ch>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "apieventhub.h"
+
+#include <QLoggingCategory>
+#include <QUuid>
+#include <QtDebug>
+
+#include "hardware/hardwarefactory.h"
+#include "logger.h"
+
+static Q_LOGGING_CATEGORY(CLASS_LC, "api.events");
+
+const QString ApiEventHub::TOPIC_CONFIG    = "config";
+const QString ApiEventHub::TOPIC_ENTITIES  = "entities";
+const QString ApiEventHub::TOPIC_LOG       = "log";
+const QString ApiEventHub::TOPIC_HARDWARE  = "hardware";
+const QString ApiEventHub::TOPIC_DISCOVERY = "discovery";
+
+const int ApiEventHub::HISTORY_SIZE = 1024;
+
+namespace {
+
+struct ConfigEvent {
+    void (Config::*signal)();
+    const char* event;  // event name of the former subscribe_events API
+    const char* path;
+};
+
+const ConfigEvent CONFIG_EVENTS[] = {
+    {&Config::configChanged, "config_changed", ""},
+    {&Config::settingsChanged, "settings_changed", "/settings"},
+    {&Config::profileIdChanged, "profileId_changed", "/ui_config/selected_profile"},
+    {&Config::profileFavoritesChanged, "profileFavorites_changed", "/ui_config/profiles"},
+    {&Config::profilesChanged, "profiles_changed", "/ui_config/profiles"},
+    {&Config::uiConfigChanged, "uiConfig_changed", "/ui_config"},
+    {&Config::pagesChanged, "pages_changed", "/ui_config/pages"},
+    {&Config::groupsChanged, "groups_changed", "/ui_config/groups"},
+};
+
+// log messages of the API itself are never published, otherwise every event would create a new one
+bool isApiCategory(const QString& category) { return category == "api" || category.startsWith("api."); }
+
+// true if one subtree contains the other
+bool pathsOverlap(const QString& a, const QString& b) {
+    if (a.isEmpty() || b.isEmpty() || a == b) {
+        return true;
+    }
+    return a.startsWith(b + '/') || b.startsWith(a + '/');
+}
+
+QSet<QString> toSet(const QVariant& list) {
+    QSet<QString> set;
+    for (const QVariant& item : list.toList()) {
+        set.insert(item.toString());
+    }
+    return set;
+}
+
+}  // namespace
+
+ApiEventHub::ApiEventHub(Config* config, Entities* entities, NetworkDiscovery* discovery, QObject* parent)
+    : QObject(parent), m_stream(QUuid::createUuid().toString(QUuid::WithoutBraces)), m_entities(entities) {
+    for (const ConfigEvent& configEvent : CONFIG_EVENTS) {
+        connect(config, configEvent.signal, this,
+                [this, configEvent]() { publishConfig(configEvent.event, configEvent.path); });
+    }
+    // the configuration is written behind: a failure is reported after the API call already succeeded
+    connect(config, &Config::configWriteError, this, [this](const QString& error) {
+        QVariantMap map;
+        map.insert("event", "config_write_failed");
+        map.insert("path", "");
+        map.insert("error", error);
+        publish(TOPIC_CONFIG, map);
+    });
+
+    connect(entities, &Entities::entityChanged, this, &ApiEventHub::onEntityChanged);
+
+    connectHardware();
+    connectDiscovery(discovery);
+}
+
+const QStringList& ApiEventHub::topics() {
+    static const QStringList topics = {TOPIC_CONFIG, TOPIC_ENTITIES, TOPIC_LOG, TOPIC_HARDWARE, TOPIC_DISCOVERY};
+    return topics;
+}
+
+bool ApiEventHub::subscribe(ApiClient* client, const QString& topic, const QVariantMap& filter, bool legacy,
+                            QString* error) {
+    if (!topics().contains(topic)) {
+        if (error) {
+            *error = QString("Unsupported topic: %1").arg(topic);
+        }
+        return false;
+    }
+
+    Subscription subscription;
+    subscription.legacy = legacy;
+    if (topic == TOPIC_CONFIG) {
+        for (const QVariant& path : filter.value("paths").toList()) {
+            subscription.paths.append(path.toString());
+        }
+    } else if (topic == TOPIC_ENTITIES) {
+        subscription.entityIds   = toSet(filter.value("entity_ids"));
+        subscription.entityTypes = toSet(filter.value("entity_types"));
+    } else if (topic == TOPIC_LOG) {
+        subscription.categories = toSet(filter.value("categories"));
+    } else if (topic == TOPIC_HARDWARE) {
+        subscription.sources = toSet(filter.value("sources"));
+    } else if (topic == TOPIC_DISCOVERY) {
+        subscription.serviceTypes = toSet(filter.value("mdns"));
+    }
+
+    m_topics[topic].insert(client, subscription);
+    qCDebug(CLASS_LC) << "Client" << client << "subscribed to" << topic;
+
+    if (topic == TOPIC_LOG) {
+        updateLogConnection();
+    }
+    return true;
+}
+
+bool ApiEventHub::unsubscribe(ApiClient* client, const QString& topic) {
+    bool removed = false;
+    for (auto iter = m_topics.begin(); iter != m_topics.end(); ++iter) {
+        if (topic.isEmpty() || iter.key() == topic) {
+            removed |= iter.value().remove(client) > 0;
+        }
+    }
+
+    updateLogConnection();
+    return removed;
+}
+
+void ApiEventHub::removeClient(ApiClient* client) {
+    unsubscribe(client);
+    unwatchEntities(client);
+}
+
+bool ApiEventHub::isSubscribed(ApiClient* client, const QString& topic) const {
+    return m_topics.value(topic).contains(client);
+}
+
+QStringList ApiEventHub::subscriptions(ApiClient* client) const {
+    QStringList list;
+    for (auto iter = m_topics.cbegin(); iter != m_topics.cend(); ++iter) {
+        if (iter.value().contains(client)) {
+            list.append(iter.key());
+        }
+    }
+    return list;
+}
+
+QVariantList ApiEventHub::watchEntities(ApiClient* client, const QStringList& entityIds, int interval) {
+    unwatchEntities(client);
+
+    EntityWatch& watch = m_entityWatches[client];
+    watch.interval     = interval;
+    for (const QString& entityId : entityIds) {
+        watch.entityIds.insert(entityId);
+    }
+    if (interval > 0) {
+        watch.timer = new QTimer(this);
+        watch.timer->setSingleShot(true);
+        watch.timer->setInterval(interval);
+        connect(watch.timer, &QTimer::timeout, this, [this, client]() { sendEntityChanges(client); });
+    }
+    qCDebug(CLASS_LC) << "Client" << client << "watching" << (entityIds.isEmpty() ? "all" : "selected") << "entities";
+
+    QVariantList states;
+    for (QObject* obj : m_entities->list()) {
+        Entity* entity = qobject_cast<Entity*>(obj);
+        if (entity && (watch.entityIds.isEmpty() || watch.entityIds.contains(entity->entity_id()))) {
+            QSet<int> attributes;
+            for (const QString& name : entity->allAttributes()) {
+                attributes.insert(entity->getAttrIndex(name));
+            }
+            states.append(entityState(entity, attributes));
+        }
+    }
+    return states;
+}
+
+bool ApiEventHub::unwatchEntities(ApiClient* client) {
+    auto iter = m_entityWatches.find(client);
+    if (iter == m_entityWatches.end()) {
+        return false;
+    }
+    delete iter->timer;
+    m_entityWatches.erase(iter);
+    return true;
+}
+
+QVariantMap ApiEventHub::statistics() const {
+    QVariantMap subscribers;
+    for (auto iter = m_topics.cbegin(); iter != m_topics.cend(); ++iter) {
+        subscribers.insert(iter.key(), iter.value().size());
+    }
+
+    QVariantMap stats;
+    stats.insert("seq", m_seq);
+    stats.insert("history", m_history.size());
+    stats.insert("published", m_published);
+    stats.insert("serialized", m_serialized);
+    stats.insert("sent", m_sent);
+    stats.insert("coalesced", m_coalesced);
+    stats.insert("entity_watches", m_entityWatches.size());
+    stats.insert("subscribers", subscribers);
+    return stats;
+}
+
+void ApiEventHub::publish(const QString& topic, QVariantMap event, const QString& legacyEvent) {
+    m_published++;
+
+    event.insert("type", "event");
+    event.insert("topic", topic);
+    event.insert("seq", ++m_seq);
+
+    HistoryEntry* entry = isReplayable(topic) ? &record(topic, event, legacyEvent) : nullptr;
+
+    auto subscribers = m_topics.constFind(topic);
+    if (subscribers == m_topics.constEnd() || subscribers->isEmpty()) {
+        return;
+    }
+
+    // encoded on first use, then shared by all matching clients
+    Encoded     local;
+    Encoded*    encoded = entry ? &entry->encoded : &local;
+    Encoded     legacyEncoded;
+    QVariantMap legacyMessage;
+    QString     key = coalesceKey(topic, event);
+
+    for (auto iter = subscribers->cbegin(); iter != subscribers->cend(); ++iter) {
+        ApiClient* client = iter.key();
+        if (!client->isValid() || !matches(iter.value(), topic, event)) {
+            continue;
+        }
+
+        if (iter->legacy) {
+            if (legacyEvent.isEmpty()) {
+                continue;
+            }
+            if (legacyMessage.isEmpty()) {
+                legacyMessage.insert("event", legacyEvent);
+            }
+            send(client, legacyMessage, &legacyEncoded, "legacy:" + legacyEvent);
+        } else {
+            send(client, event, encoded, key);
+        }
+    }
+}
+
+void ApiEventHub::send(ApiClient* client, const QVariantMap& message, Encoded* encoded, const QString& key) {
+    if (client->encoding() == ApiClient::Encoding::Cbor) {
+        if (encoded->cbor.isEmpty()) {
+            encoded->cbor = ApiClient::toCbor(message);
+            m_serialized++;
+        }
+        client->sendEvent(encoded->cbor, key);
+    } else {
+        if (encoded->json.isEmpty()) {
+            encoded->json = ApiClient::toJson(message);
+            m_serialized++;
+        }
+        client->sendEvent(encoded->json, key);
+    }
+    m_sent++;
+}
+
+ApiEventHub::HistoryEntry& ApiEventHub::record(const QString& topic, const QVariantMap& event,
+                                               const QString& legacyEvent) {
+    HistoryEntry entry;
+    entry.seq         = m_seq;
+    entry.topic       = topic;
+    entry.event       = event;
+    entry.legacyEvent = legacyEvent;
+
+    if (m_history.size() < HISTORY_SIZE) {
+        m_history.append(entry);
+        return m_history.last();
+    }
+
+    // overwrite the oldest event
+    HistoryEntry& slot = m_history[m_historyNext];
+    m_evictedSeq       = slot.seq;
+    slot               = entry;
+    m_historyNext      = (m_historyNext + 1) % HISTORY_SIZE;
+    return slot;
+}
+
+bool ApiEventHub::canReplay(quint64 from) const {
+    // otherwise events have been lost or the sequence number belongs to a former stream
+    return from >= m_evictedSeq && from <= m_seq;
+}
+
+bool ApiEventHub::replay(ApiClient* client, quint64 from) {
+    if (!canReplay(from)) {
+        return false;
+    }
+
+    int replayed = 0;
+    for (int i = 0; i < m_history.size(); i++) {
+        HistoryEntry& entry = m_history[(m_historyNext + i) % m_history.size()];
+        if (entry.seq <= from) {
+            continue;
+        }
+
+        auto subscribers = m_topics.constFind(entry.topic);
+        if (subscribers == m_topics.constEnd()) {
+            continue;
+        }
+        auto subscription = subscribers->constFind(client);
+        if (subscription == subscribers->constEnd() || subscription->legacy ||
+            !matches(subscription.value(), entry.topic, entry.event)) {
+            continue;
+        }
+
+        send(client, entry.event, &entry.encoded, coalesceKey(entry.topic, entry.event));
+        replayed++;
+    }
+
+    qCDebug(CLASS_LC) << "Replayed" << replayed << "events after" << from << "to" << client;
+    return true;
+}
+
+QString ApiEventHub::coalesceKey(const QString& topic, const QVariantMap& event) {
+    // a queued state event is superseded by a newer event with the same key
+    if (topic == TOPIC_CONFIG) {
+        // every write error is delivered
+        if (event.value("event") == "config_write_failed") {
+            return QString();
+        }
+        return "config:" + event.value("path").toString();
+    }
+    if (topic == TOPIC_ENTITIES) {
+        return "entities:" + event.value("entity_id").toString() + ':' + event.value("attribute").toString();
+    }
+    if (topic == TOPIC_HARDWARE) {
+        return "hardware:" + event.value("source").toString() + ':' + event.value("event").toString();
+    }
+    if (topic == TOPIC_DISCOVERY) {
+        return "discovery:" + event.value("mdns").toString() + '/' + event.value("name").toString();
+    }
+    return QString();
+}
+
+bool ApiEventHub::matches(const Subscription& subscription, const QString& topic, const QVariantMap& event) const {
+    if (topic == TOPIC_CONFIG) {
+        if (subscription.paths.isEmpty()) {
+            return true;
+        }
+        QString path = event.value("path").toString();
+        for (const QString& filter : subscription.paths) {
+            if (pathsOverlap(filter, path)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    if (topic == TOPIC_ENTITIES) {
+        if (!subscription.entityIds.isEmpty() && !subscription.entityIds.contains(event.value("entity_id").toString())) {
+            return false;
+        }
+        return subscription.entityTypes.isEmpty() ||
+               subscription.entityTypes.contains(event.value("entity_type").toString());
+    }
+    if (topic == TOPIC_LOG) {
+        return subscription.categories.isEmpty() || subscription.categories.contains(event.value("cat").toString());
+    }
+    if (topic == TOPIC_HARDWARE) {
+        return subscription.sources.isEmpty() || subscription.sources.contains(event.value("source").toString());
+    }
+    if (topic == TOPIC_DISCOVERY) {
+        return subscription.serviceTypes.isEmpty() ||
+               subscription.serviceTypes.contains(event.value("mdns").toString());
+    }
+    return false;
+}
+
+void ApiEventHub::publishConfig(const QString& event, const QString& path) {
+    QVariantMap map;
+    map.insert("event", event);
+    map.insert("path", path);
+    publish(TOPIC_CONFIG, map, event);
+}
+
+void ApiEventHub::onEntityChanged(Entity* entity, int attrIndex) {
+    // hot path: nothing is built without an API client interested in entity changes
+    auto subscribers = m_topics.constFind(TOPIC_ENTITIES);
+    if ((subscribers == m_topics.constEnd() || subscribers->isEmpty()) && m_entityWatches.isEmpty()) {
+        return;
+    }
+
+    QVariantMap map;
+    map.insert("event", "entity_changed");
+    map.insert("entity_id", entity->entity_id());
+    map.insert("entity_type", entity->type());
+    map.insert("attribute", entity->getAttrName(attrIndex).toLower());
+    map.insert("state", entity->stateText());
+    publish(TOPIC_ENTITIES, map);
+
+    QString entityId = entity->entity_id();
+    for (auto iter = m_entityWatches.begin(); iter != m_entityWatches.end(); ++iter) {
+        EntityWatch& watch = iter.value();
+        if (!watch.entityIds.isEmpty() && !watch.entityIds.contains(entityId)) {
+            continue;
+        }
+
+        QSet<int>& attributes = watch.pending[entityId];
+        if (attributes.contains(attrIndex)) {
+            // the latest value is read when sending
+            m_coalesced++;
+        }
+        attributes.insert(attrIndex);
+
+        if (!watch.timer) {
+            sendEntityChanges(iter.key());
+        } else if (!watch.timer->isActive()) {
+            // the window starts with the first change, a continuous stream of changes is sent once per interval
+            watch.timer->start();
+        }
+    }
+}
+
+void ApiEventHub::sendEntityChanges(ApiClient* client) {
+    auto watch = m_entityWatches.find(client);
+    if (watch == m_entityWatches.end() || watch->pending.isEmpty()) {
+        return;
+    }
+    if (watch->timer && client->isCongested()) {
+        // keep collecting changes until the client caught up
+        watch->timer->start();
+        return;
+    }
+
+    QVariantList changes;
+    for (auto iter = watch->pending.cbegin(); iter != watch->pending.cend(); ++iter) {
+        // the entity might have been removed in the meantime
+        Entity* entity = qobject_cast<Entity*>(m_entities->get(iter.key()));
+        if (entity) {
+            changes.append(entityState(entity, iter.value()));
+        }
+    }
+    watch->pending.clear();
+
+    if (changes.isEmpty() || !client->isValid()) {
+        return;
+    }
+
+    QVariantMap message;
+    message.insert("type", "event");
+    message.insert("topic", "entity_state");
+    message.insert("entities", changes);
+    // deltas must not be coalesced, they are merged in the pending changes instead
+    Encoded encoded;
+    send(client, message, &encoded, QString());
+}
+
+QVariantMap ApiEventHub::entityState(Entity* entity, const QSet<int>& attributes) {
+    // attribute index -> value, JSON object keys must be strings
+    QVariantMap values;
+    for (int attrIndex : attributes) {
+        values.insert(QString::number(attrIndex), entity->getAttrValue(attrIndex));
+    }
+
+    QVariantMap state;
+    state.insert("entity_id", entity->entity_id());
+    state.insert("attributes", values);
+    return state;
+}
+
+void ApiEventHub::onMessageLogged(int type, const QString& category, const QString& message, uint timestamp) {
+    if (isApiCategory(category)) {
+        return;
+    }
+
+    QVariantMap map;
+    map.insert("event", "log");
+    map.insert("level", type);
+    map.insert("cat", category);
+    map.insert("time", QString::number(timestamp));
+    map.insert("msg", message);
+    publish(TOPIC_LOG, map);
+}
+
+void ApiEventHub::connectHardware() {
+    HardwareFactory* hwFactory = HardwareFactory::instance();
+    if (hwFactory == nullptr) {
+        qCWarning(CLASS_LC) << "No hardware factory: hardware events are not available";
+        return;
+    }
+
+    BatteryFuelGauge* battery      = hwFactory->getBatteryFuelGauge();
+    auto              batteryEvent = [this, battery](const QString& event) {
+        QVariantMap map;
+        map.insert("event", event);
+        map.insert("source", "battery");
+        map.insert("level", battery->getLevel());
+        map.insert("charging", battery->getIsCharging());
+        publish(TOPIC_HARDWARE, map);
+    };
+    connect(battery, &BatteryFuelGauge::levelChanged, this, [=]() { batteryEvent("level_changed"); });
+    connect(battery, &BatteryFuelGauge::isChargingChanged, this, [=]() { batteryEvent("charging_changed"); });
+    connect(battery, &BatteryFuelGauge::chargingDone, this, [=]() { batteryEvent("charging_done"); });
+    connect(battery, &BatteryFuelGauge::lowBattery, this, [=]() { batteryEvent("low_battery"); });
+    connect(battery, &BatteryFuelGauge::criticalLowBattery, this, [=]() { batteryEvent("critical_low_battery"); });
+
+    WifiControl* wifi      = hwFactory->getWifiControl();
+    auto         wifiEvent = [this, wifi](const QString& event) {
+        WifiStatus  status = wifi->wifiStatus();
+        QVariantMap map;
+        map.insert("event", event);
+        map.insert("source", "wifi");
+        map.insert("connected", status.isConnected());
+        map.insert("ssid", status.name());
+        map.insert("rssi", status.rssi());
+        publish(TOPIC_HARDWARE, map);
+    };
+    connect(wifi, &WifiControl::connected, this, [=]() { wifiEvent("connected"); });
+    connect(wifi, &WifiControl::disconnected, this, [=]() { wifiEvent("disconnected"); });
+    connect(wifi, &WifiControl::signalStrengthChanged, this, [=](int) { wifiEvent("signal_strength_changed"); });
+}
+
+void ApiEventHub::connectDiscovery(NetworkDiscovery* discovery) {
+    auto discoveryEvent = [this](const QString& event, const QVariantMap& service) {
+        QVariantMap map = service;
+        map.insert("event", event);
+        publish(TOPIC_DISCOVERY, map);
+    };
+    connect(discovery, &NetworkDiscovery::serviceAdded, this,
+            [=](const QVariantMap& service) { discoveryEvent("service_added", service); });
+    connect(discovery, &NetworkDiscovery::serviceUpdated, this,
+            [=](const QVariantMap& service) { discoveryEvent("service_updated", service); });
+    connect(discovery, &NetworkDiscovery::serviceRemoved, this,
+            [=](const QVariantMap& service) { discoveryEvent("service_removed", service); });
+}
+
+void ApiEventHub::updateLogConnection() {
+    // log messages are only forwarded while somebody is listening
+    bool listening = !m_topics.value(TOPIC_LOG).isEmpty();
+    if (listening && !m_logConnection) {
+        Logger* logger = Logger::getInstance();
+        if (logger) {
+            m_logConnection = connect(logger, &Logger::messageLogged, this, &ApiEventHub::onMessageLogged,
+                                      Qt::QueuedConnection);
+        }
+    } else if (!listening && m_logConnection) {
+        disconnect(m_logConnection);
+        m_logConnection = QMetaObject::Connection();
+    }
+}
@@ -0,0 +1,202 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2020 Markus Zehnder <business@markuszehnder.ch>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+#include <QTimer>
+#include <QVariantMap>
+#include <QVector>
+
+#include "apiclient.h"
+#include "config.h"
+#include "entities/entities.h"
+#include "networkdiscovery.h"
+
+/**
+ * @brief ApiEventHub distributes events to the subscribed API clients.
+ * Clients subscribe to topics with an optional filter:
+ * - config: "paths" JSON pointers of the configuration subtrees of interest
+ * - entities: "entity_ids" and / or "entity_types"
+ * - log: "categories"
+ * - hardware: "sources" (battery, wifi)
+ * - discovery: "mdns" service types
+ * Every event is encoded at most once per encoding (JSON, CBOR) and shared by all matching clients.
+ * Events carry a monotonically increasing sequence number. The most recent events are kept in a ring buffer, which
+ * allows reconnecting clients to resume from the last received event.
+ *
+ * Additionally clients can watch the attribute state of entities: changed attributes are collected per client within
+ * a coalescing window and sent as one delta message.
+ */
+class ApiEventHub : public QObject {
+    Q_OBJECT
+
+ public:
+    static const QString TOPIC_CONFIG;
+    static const QString TOPIC_ENTITIES;
+    static const QString TOPIC_LOG;
+    static const QString TOPIC_HARDWARE;
+    static const QString TOPIC_DISCOVERY;
+
+    static const int HISTORY_SIZE;  // number of buffered events for resuming clients
+
+    ApiEventHub(Config* config, Entities* entities, NetworkDiscovery* discovery, QObject* parent = nullptr);
+
+    static const QStringList& topics();
+
+    /**
+     * @brief Subscribes the client to a topic. An existing subscription of the topic is replaced.
+     * @param filter Topic specific filter, an empty filter matches all events of the topic
+     * @param legacy Send the plain {"event": name} messages of the former subscribe_events API
+     * @param error Returns the error message
+     */
+    bool subscribe(ApiClient* client, const QString& topic, const QVariantMap& filter, bool legacy = false,
+                   QString* error = nullptr);
+
+    /**
+     * @brief Removes the subscription of a topic. An empty topic removes all subscriptions of the client.
+     * @return false if the client wasn't subscribed
+     */
+    bool unsubscribe(ApiClient* client, const QString& topic = QString());
+
+    /**
+     * @brief Removes all subscriptions of a disconnected client.
+     */
+    void removeClient(ApiClient* client);
+
+    /**
+     * @brief Returns true if all events following the given sequence number are still buffered.
+     */
+    bool canReplay(quint64 from) const;
+
+    /**
+     * @brief Returns false for topics whose events are not buffered and never replayed: log messages and entity changes
+     * would quickly displace all other events. Log messages are available with the logger queue, entity states with
+     * get_entity_states and subscribe_entities.
+     */
+    static bool isReplayable(const QString& topic) { return topic != TOPIC_LOG && topic != TOPIC_ENTITIES; }
+
+    /**
+     * @brief Sends the buffered events following the given sequence number which match the client subscriptions.
+     * @return false if the gap is larger than the buffer or the sequence number is unknown: the client has to fetch a
+     * new snapshot
+     */
+    bool replay(ApiClient* client, quint64 from);
+
+    /**
+     * @brief Sequence number of the last published event.
+     */
+    quint64 sequence() const { return m_seq; }
+
+    /**
+     * @brief Identifies the event stream of this instance: sequence numbers restart with a new stream.
+     */
+    QString stream() const { return m_stream; }
+
+    bool        isSubscribed(ApiClient* client, const QString& topic) const;
+    QStringList subscriptions(ApiClient* client) const;
+
+    /**
+     * @brief Starts sending the changed attributes of the given entities to the client. An existing watch is replaced.
+     * @param entityIds Entities to watch, empty for all entities
+     * @param interval Coalescing window in milliseconds, 0 sends every change immediately
+     * @return The current attribute values of the watched entities
+     */
+    QVariantList watchEntities(ApiClient* client, const QStringList& entityIds, int interval);
+    bool         unwatchEntities(ApiClient* client);
+
+    /**
+     * @brief Returns the number of published events, serialized and sent messages.
+     */
+    QVariantMap statistics() const;
+
+ private:
+    struct Subscription {
+        QStringList   paths;
+        QSet<QString> entityIds;
+        QSet<QString> entityTypes;
+        QSet<QString> categories;
+        QSet<QString> sources;
+        QSet<QString> serviceTypes;
+        bool          legacy = false;
+    };
+
+    // lazily encoded message
+    struct Encoded {
+        QString    json;
+        QByteArray cbor;
+    };
+
+    struct HistoryEntry {
+        quint64     seq = 0;
+        QString     topic;
+        QVariantMap event;
+        QString     legacyEvent;
+        Encoded     encoded;
+    };
+
+    struct EntityWatch {
+        QSet<QString>             entityIds;
+        int                       interval = 0;
+        QTimer*                   timer    = nullptr;
+        QHash<QString, QSet<int>> pending;  // entity id -> changed attribute indices
+    };
+
+    void          publish(const QString& topic, QVariantMap event, const QString& legacyEvent = QString());
+    HistoryEntry& record(const QString& topic, const QVariantMap& event, const QString& legacyEvent);
+    void          send(ApiClient* client, const QVariantMap& message, Encoded* encoded, const QString& key);
+    bool          matches(const Subscription& subscription, const QString& topic, const QVariantMap& event) const;
+
+    static QVariantMap entityState(Entity* entity, const QSet<int>& attributes);
+    static QString     coalesceKey(const QString& topic, const QVariantMap& event);
+
+    void publishConfig(const QString& event, const QString& path);
+    void onEntityChanged(Entity* entity, int attrIndex);
+    void sendEntityChanges(ApiClient* client);
+    void onMessageLogged(int type, const QString& category, const QString& message, uint timestamp);
+    void connectHardware();
+    void connectDiscovery(NetworkDiscovery* discovery);
+    void updateLogConnection();
+
+    // topic -> subscribed clients
+    QHash<QString, QHash<ApiClient*, Subscription>> m_topics;
+    QHash<ApiClient*, EntityWatch>                  m_entityWatches;
+
+    // event history ring buffer
+    QVector<HistoryEntry> m_history;
+    int                   m_historyNext = 0;  // oldest entry once the buffer is full
+    quint64               m_seq         = 0;
+    quint64               m_evictedSeq  = 0;  // sequence number of the last overwritten event
+    QString               m_stream;
+
+    Entities* m_entities;
+
+    QMetaObject::Connection m_logConnection;
+
+    quint32 m_published  = 0;
+    quint32 m_serialized = 0;
+    quint32 m_sent       = 0;
+    quint32 m_coalesced  = 0;
+};
@@ -0,0 +1,164 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2020 Markus Zehnder <business@markuszehnder.ch>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+
+#include "apiserver.h"
+
+#include <QCborValue>
+#include <QJsonDocument>
+#include <QLoggingCategory>
+#include <QtDebug>
+
+static Q_LOGGING_CATEGORY(CLASS_LC, "api.server");
+
+ApiServer::ApiServer(const QElapsedTimer &clock, QObject *parent) : QObject(parent), m_clock(clock) {}
+
+void ApiServer::setLimits(const ApiClient::Limits &limits) {
+    QMutexLocker locker(&m_mutex);
+    m_limits = limits;
+}
+
+QVariantMap ApiServer::statistics() const {
+    QMutexLocker locker(&m_mutex);
+
+    QVariantMap stats;
+    stats.insert("decode", m_decodeLatency.toVariantMap());
+    return stats;
+}
+
+bool ApiServer::listen(quint16 port) {
+    if (!m_server) {
+        m_server = new QWebSocketServer(QStringLiteral("YIO API"), QWebSocketServer::NonSecureMode, this);
+        connect(m_server, &QWebSocketServer::newConnection, this, &ApiServer::onNewConnection);
+    }
+
+    if (!m_server->listen(QHostAddress::Any, port)) {
+        qCWarning(CLASS_LC) << "Cannot listen on port" << port << m_server->errorString();
+        return false;
+    }
+    return true;
+}
+
+void ApiServer::close() {
+    if (m_server) {
+        m_server->close();
+    }
+
+    for (auto iter = m_clients.cbegin(); iter != m_clients.cend(); ++iter) {
+        iter.key()->disconnect(this);
+        iter.key()->close();
+    }
+    m_clients.clear();
+}
+
+void ApiServer::onNewConnection() {
+    QWebSocket *socket = m_server->nextPendingConnection();
+
+    connect(socket, &QWebSocket::textMessageReceived, this, &ApiServer::onTextMessage);
+    connect(socket, &QWebSocket::binaryMessageReceived, this, &ApiServer::onBinaryMessage);
+    connect(socket, &QWebSocket::disconnected, this, &ApiServer::onDisconnected);
+
+    // outbound queue limits are read on connect: changed settings apply to new connections
+    ApiClient::Limits limits;
+    {
+        QMutexLocker locker(&m_mutex);
+        limits = m_limits;
+    }
+
+    // the client is owned and deleted by the receiver of clientConnected
+    ApiClient *client = new ApiClient(socket, limits);
+    m_clients.insert(socket, client);
+    emit clientConnected(socket, client);
+
+    // send message to client after connected to authenticate
+    QVariantMap map;
+    map.insert("type", "auth_required");
+    client->send(map);
+}
+
+void ApiServer::onTextMessage(const QString &message) {
+    QWebSocket *socket = qobject_cast<QWebSocket *>(sender());
+    if (!socket || !m_clients.contains(socket)) {
+        return;
+    }
+
+    qint64 received = m_clock.nsecsElapsed();
+
+    // convert message to json
+    QJsonParseError parseerror;
+    QJsonDocument   doc = QJsonDocument::fromJson(message.toUtf8(), &parseerror);
+    if (parseerror.error != QJsonParseError::NoError) {
+        qCWarning(CLASS_LC) << "JSON error:" << parseerror.errorString();
+        return;
+    }
+    QVariant request = doc.toVariant();
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_decodeLatency.record((m_clock.nsecsElapsed() - received) / 1000);
+    }
+    emit requestReceived(socket, request, received);
+}
+
+void ApiServer::onBinaryMessage(const QByteArray &message) {
+    QWebSocket *socket = qobject_cast<QWebSocket *>(sender());
+    if (!socket) {
+        return;
+    }
+
+    auto clientIter = m_clients.constFind(socket);
+    if (clientIter == m_clients.constEnd()) {
+        return;
+    }
+
+    qint64 received = m_clock.nsecsElapsed();
+
+    // binary frames are CBOR encoded: decoded straight into the request map without a JSON detour
+    QCborParserError parseerror;
+    QCborValue       value = QCborValue::fromCbor(message, &parseerror);
+    if (parseerror.error != QCborError::NoError) {
+        qCWarning(CLASS_LC) << "CBOR error:" << parseerror.errorString();
+        return;
+    }
+    QVariant request = value.toVariant();
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_decodeLatency.record((m_clock.nsecsElapsed() - received) / 1000);
+    }
+
+    ApiClient *client = clientIter.value();
+    if (client->encoding() != ApiClient::Encoding::Cbor) {
+        qCDebug(CLASS_LC) << "Client switched to CBOR encoding:" << socket;
+        client->setEncoding(ApiClient::Encoding::Cbor);
+    }
+
+    emit requestReceived(socket, request, received);
+}
+
+void ApiServer::onDisconnected() {
+    QWebSocket *socket = qobject_cast<QWebSocket *>(sender());
+    if (socket && m_clients.remove(socket) > 0) {
+        qCDebug(CLASS_LC) << "Client disconnected" << socket;
+        emit clientDisconnected(socket);
+    }
+}
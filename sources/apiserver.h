@@ -0,0 +1,99 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2020 Markus Zehnder <business@markuszehnder.ch>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QVariant>
+#include <QtWebSockets/QWebSocket>
+#include <QtWebSockets/QWebSocketServer>
+
+#include "apiclient.h"
+#include "latencyhistogram.h"
+
+/**
+ * @brief ApiServer is the transport layer of the YIO API. It lives in its own thread and runs the WebSocket server,
+ * the client connections with their send queues, and decodes the received JSON and CBOR requests.
+ * Decoded requests are passed to the GUI thread with the requestReceived signal, which never touches the sockets.
+ * Responses are encoded and written in the server thread, see ApiClient.
+ */
+class ApiServer : public QObject {
+    Q_OBJECT
+
+ public:
+    /**
+     * @param clock Reference clock of the request receive timestamps
+     */
+    explicit ApiServer(const QElapsedTimer& clock, QObject* parent = nullptr);
+
+    /**
+     * @brief Sets the send queue limits of new connections. Thread safe.
+     */
+    void setLimits(const ApiClient::Limits& limits);
+
+    /**
+     * @brief Returns the request decoding latency. Thread safe.
+     */
+    QVariantMap statistics() const;
+
+ public slots:  // NOLINT open issue: https://github.com/cpplint/cpplint/pull/99
+    bool listen(quint16 port);
+
+    /**
+     * @brief Stops listening and closes all client connections. The clients are not reported as disconnected: the
+     * caller is responsible for deleting them.
+     */
+    void close();
+
+ signals:
+    /**
+     * @brief Emitted for a new connection. The receiver owns the client and deletes it after clientDisconnected.
+     */
+    void clientConnected(QWebSocket* socket, ApiClient* client);
+    void clientDisconnected(QWebSocket* socket);
+
+    /**
+     * @brief Emitted for each decoded request.
+     * @param request A request map or a list of requests
+     * @param received Receive timestamp in nanoseconds of the reference clock
+     */
+    void requestReceived(QWebSocket* socket, const QVariant& request, qint64 received);
+
+ private slots:  // NOLINT open issue: https://github.com/cpplint/cpplint/pull/99
+    void onNewConnection();
+    void onTextMessage(const QString& message);
+    void onBinaryMessage(const QByteArray& message);
+    void onDisconnected();
+
+ private:
+    QElapsedTimer                  m_clock;
+    QWebSocketServer*              m_server = nullptr;
+    QHash<QWebSocket*, ApiClient*> m_clients;
+
+    mutable QMutex    m_mutex;
+    ApiClient::Limits m_limits;
+    LatencyHistogram  m_decodeLatency;
+};
@@ -23,8 +23,14 @@
 
 #include "config.h"
 
+#include <QElapsedTimer>
 #include <QJsonDocument>
 #include <QLoggingCategory>
+#include <QRandomGenerator>
+#include <QTimer>
+
+#include "configsnapshot.h"
+#include "configutil.h"
 
 static Q_LOGGING_CATEGORY(CLASS_LC, "config");
 
@@ -41,14 +47,34 @@ const QString Config::OBJ_DATA = CFG_OBJ_DATA;
 
 Config *Config::s_instance = nullptr;
 
+static const int DEFAULT_WRITE_DELAY = 1000;         // milliseconds
+static const int SNAPSHOT_VALIDATION_DELAY = 10000;  // milliseconds
+
 ConfigInterface::~ConfigInterface() {}
 
 Config::Config(QQmlApplicationEngine *engine, QString configFilePath, QString schemaFilePath, QString appPath)
-    : m_engine(engine), m_jsf(configFilePath, schemaFilePath), m_error("") {
+    : m_engine(engine),
+      m_jsf(configFilePath, schemaFilePath),
+      m_writer(new ConfigWriter(configFilePath, schemaFilePath, DEFAULT_WRITE_DELAY, this)),
+      m_error(""),
+      m_revision(QRandomGenerator::global()->generate64() >> 12) {
     Q_ASSERT(engine);
 
     s_instance = this;
 
+    connect(m_writer, &ConfigWriter::committed, this, [this](bool success, const QString &error) {
+        m_error = error;
+        if (!success) {
+            emit configWriteError(m_error);
+        }
+    });
+    connect(m_writer, &ConfigWriter::validated, this, [this](bool valid, const QString &error) {
+        if (!valid) {
+            m_error = error;
+            qCCritical(CLASS_LC).noquote() << "Invalid configuration!" << endl << m_error;
+        }
+    });
+
     // load translations file
     JsonFile translationCfg(appPath.append(QString("/translations.json")), "");
     m_languages = translationCfg.read().toList();
@@ -68,7 +94,8 @@ void Config::setFavorite(const QString &entityId, bool value) {
     }
 
     m_cacheUIProfile.insert("favorites", fav);
-    writeConfig();
+    m_cacheUIProfiles.insert(m_cacheProfileId, m_cacheUIProfile);
+    writeConfig({ConfigUtil::jsonPointer({"ui_config", "profiles", m_cacheProfileId})});
     emit profileFavoritesChanged();
 }
 
@@ -80,58 +107,236 @@ void Config::setConfig(const QVariantMap &config) {
 
     m_config = config;
     syncConfigToCache();
-    emit configChanged();
-    writeConfig();
+    if (m_txDepth > 0) {
+        m_txConfigChanged = true;
+    } else {
+        emit configChanged();
+    }
+    // already validated
+    writeConfig(QStringList());
+}
+
+bool Config::setConfig(const QVariantMap &config, const QStringList &changedPaths) {
+    m_error.clear();
+    // within a transaction the changed subtrees are validated when committing
+    if (m_txDepth == 0 && !validateSubtrees(config, changedPaths)) {
+        return false;
+    }
+
+    m_config = config;
+    syncConfigToCache();
+    if (m_txDepth > 0) {
+        m_txConfigChanged = true;
+        writeConfig(changedPaths);
+    } else {
+        emit configChanged();
+        // already validated
+        writeConfig(QStringList());
+    }
+    return true;
+}
+
+bool Config::validateSubtrees(const QVariantMap &config, const QStringList &paths) {
+    for (const QString &path : paths) {
+        // A removed subtree changes the keys of its container: required and additionalProperties of the enclosing
+        // schemas are only checked by the full validation.
+        bool     found;
+        QVariant value = ConfigUtil::getValueByPointer(config, path, &found);
+        if (!found || !m_jsf.hasSubschema(path)) {
+            return m_jsf.validate(QJsonDocument::fromVariant(config), m_error);
+        }
+        // only the subtree is converted and validated
+        if (!m_jsf.validate(QJsonValue::fromVariant(value), path, m_error)) {
+            return false;
+        }
+    }
+    return true;
 }
 
 bool Config::readConfig() {
-    // load the config.json file from the filesystem
-    m_config = m_jsf.read().toMap();
-    m_error = m_jsf.error();
+    QElapsedTimer timer;
+    timer.start();
+
+    ConfigSnapshot snapshot(m_jsf.name(), m_jsf.schemaPath());
+    if (snapshot.load(&m_config)) {
+        m_error.clear();
+        qCInfo(CLASS_LC) << "Configuration loaded from snapshot in" << timer.elapsed() << "ms";
+        // the snapshot has been validated when it was written: validating again is only a safety net
+        QTimer::singleShot(SNAPSHOT_VALIDATION_DELAY, this, [this]() { m_writer->validate(m_config); });
+    } else {
+        // load the config.json file from the filesystem
+        m_config = m_jsf.read().toMap();
+        m_error = m_jsf.error();
+        qCInfo(CLASS_LC) << "Configuration loaded in" << timer.elapsed() << "ms";
+        if (m_jsf.isValid()) {
+            m_writer->saveSnapshot(m_config);
+        }
+    }
+
     syncConfigToCache();
     emit configChanged();
 
-    return m_jsf.isValid();
+    return m_error.isEmpty();
+}
+
+bool Config::writeConfig() { return writeConfig(QStringList(QString())); }
+
+bool Config::writeConfig(const QStringList &changedPaths) {
+    syncCacheToConfig();
+
+    if (m_txDepth > 0) {
+        m_txDirty = true;
+        for (const QString &path : changedPaths) {
+            if (!m_txPaths.contains(path)) {
+                m_txPaths.append(path);
+            }
+        }
+        return true;
+    }
+
+    m_revision++;
+    m_writer->schedule(m_config, changedPaths);
+    return true;
 }
 
-bool Config::writeConfig() {
+void Config::beginTransaction() {
+    if (m_txDepth++ > 0) {
+        return;
+    }
+
     syncCacheToConfig();
-    bool result = m_jsf.write(m_config);
-    m_error = m_jsf.error();
+    m_txBackup = m_config;
+    m_txPaths.clear();
+    m_txDirty = false;
+    m_txConfigChanged = false;
+    m_txRollback = false;
+    m_txActions.clear();
+}
+
+bool Config::commitTransaction() {
+    if (m_txDepth == 0) {
+        qCWarning(CLASS_LC) << "Commit without transaction";
+        return false;
+    }
+    if (--m_txDepth > 0) {
+        return !m_txRollback;
+    }
+
+    if (m_txRollback) {
+        restoreTransactionBackup();
+        return false;
+    }
+    if (!m_txDirty) {
+        runCommitActions();
+        return true;
+    }
+
+    syncCacheToConfig();
+    m_error.clear();
+    if (!validateSubtrees(m_config, m_txPaths)) {
+        QString error = m_error;
+        qCWarning(CLASS_LC) << "Rolling back invalid configuration transaction:" << error;
+        restoreTransactionBackup();
+        m_error = error;
+        return false;
+    }
+
+    bool configModified = m_txConfigChanged;
+    m_txBackup.clear();
+    m_txPaths.clear();
+    m_txDirty = false;
+    m_txConfigChanged = false;
+
+    if (configModified) {
+        emit configChanged();
+    }
+    // already validated
+    bool result = writeConfig(QStringList());
+    runCommitActions();
+    return result;
+}
+
+void Config::rollbackTransaction() {
+    if (m_txDepth == 0) {
+        qCWarning(CLASS_LC) << "Rollback without transaction";
+        return;
+    }
+    if (--m_txDepth > 0) {
+        m_txRollback = true;
+        return;
+    }
+
+    restoreTransactionBackup();
+}
+
+void Config::afterCommit(std::function<void()> action) {
+    if (m_txDepth > 0) {
+        m_txActions.append(action);
+    } else {
+        action();
+    }
+}
+
+void Config::runCommitActions() {
+    // an action may start a new transaction
+    QList<std::function<void()>> actions;
+    actions.swap(m_txActions);
+    for (const auto &action : actions) {
+        action();
+    }
+}
+
+void Config::restoreTransactionBackup() {
+    m_config = m_txBackup;
+    m_txBackup.clear();
+    m_txPaths.clear();
+    m_txDirty = false;
+    m_txConfigChanged = false;
+    m_txRollback = false;
+    // the in-memory modifications belong to the rolled back configuration
+    m_txActions.clear();
+
+    syncConfigToCache();
+    emit configChanged();
+}
+
+bool Config::flush() {
+    bool result = m_writer->flush();
     if (!result) {
-        emit configWriteError(m_error);
+        qCWarning(CLASS_LC) << "Error writing pending configuration changes";
     }
     return result;
 }
 
 void Config::setSettings(const QVariantMap &config) {
     m_cacheSettings = config;
-    writeConfig();
+    applyPersistenceSettings();
+    writeConfig({"/settings"});
     emit settingsChanged();
 }
 
 void Config::setProfiles(const QVariantMap &config) {
     m_cacheUIProfiles = config;
     m_cacheUIProfile = m_cacheUIProfiles[m_cacheProfileId].toMap();
-    writeConfig();
+    writeConfig({"/ui_config/profiles"});
     emit profilesChanged();
 }
 
 void Config::setUIConfig(const QVariantMap &config) {
     m_cacheUIConfig = config;
-    writeConfig();
+    writeConfig({"/ui_config"});
     emit uiConfigChanged();
 }
 
 void Config::setPages(const QVariantMap &config) {
     m_cacheUIPages = config;
-    writeConfig();
+    writeConfig({"/ui_config/pages"});
     emit pagesChanged();
 }
 
 void Config::setGroups(const QVariantMap &config) {
     m_cacheUIGroups = config;
-    writeConfig();
+    writeConfig({"/ui_config/groups"});
     emit groupsChanged();
 }
 
@@ -140,7 +345,7 @@ void Config::setUnitSystem(UnitSystem::Enum value) {
         m_cacheUnitSystem = value;
         emit unitSystemChanged();
     }
-    writeConfig();
+    writeConfig({"/settings/unit"});
 }
 
 QObject *Config::getQMLObject(QList<QObject *> nodes, const QString &name) {
@@ -164,7 +369,7 @@ void Config::setProfileId(QString id) {
     m_cacheProfileId = id;
     m_cacheUIProfile = m_cacheUIProfiles[m_cacheProfileId].toMap();
 
-    writeConfig();
+    writeConfig({"/ui_config/selected_profile"});
     emit profileIdChanged();
 }
 
@@ -180,6 +385,13 @@ void Config::syncConfigToCache() {
     m_cacheUIProfile = m_cacheUIProfiles[m_cacheProfileId].toMap();
 
     m_cacheUnitSystem = stringToEnum<UnitSystem::Enum>(m_cacheSettings["unit"], UnitSystem::METRIC);
+
+    applyPersistenceSettings();
+}
+
+void Config::applyPersistenceSettings() {
+    m_writer->setWriteDelay(
+        ConfigUtil::getValue(m_cacheSettings, "persistence/writeDelay", DEFAULT_WRITE_DELAY).toInt());
 }
 
 void Config::syncCacheToConfig() {
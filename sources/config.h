@@ -23,11 +23,14 @@
 #pragma once
 
 #include <QJsonArray>
+#include <QList>
 #include <QObject>
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
 #include <QtDebug>
+#include <functional>
 
+#include "configwriter.h"
 #include "jsonfile.h"
 #include "yio-interface/configinterface.h"
 #include "yio-interface/unitsystem.h"
@@ -72,6 +75,14 @@ class Config : public QObject, public ConfigInterface {
     QVariantMap getConfig() override { return m_config; }
     void        setConfig(const QVariantMap& config) override;
 
+    /**
+     * @brief Replaces the configuration after a partial modification. Only the changed subtrees are validated.
+     * @param config The complete, modified configuration
+     * @param changedPaths JSON pointers of the modified subtrees
+     * @return false if the validation failed. The configuration is not modified in this case.
+     */
+    bool setConfig(const QVariantMap& config, const QStringList& changedPaths);
+
     // profile Id
     QString getProfileId() { return m_cacheProfileId; }
     void    setProfileId(QString id);
@@ -124,11 +135,65 @@ class Config : public QObject, public ConfigInterface {
     // read configuration to file
     bool readConfig();
     /**
-     * @brief Persists the configuration. In case of an error, configWriteError is emitted.
-     * @return true if configuration could be successfully written
+     * @brief Persists the configuration. The write operation is performed asynchronously by the write-behind
+     * ConfigWriter: changes within the configured write delay are coalesced into one file write. In case of an error,
+     * configWriteError is emitted.
+     * @return true if the configuration has been scheduled for writing. The result of the write is reported later with
+     * configWriteError and lastWriteResult.
      */
     bool writeConfig();
 
+    /**
+     * @brief Returns false if the last write of the configuration file failed.
+     */
+    Q_INVOKABLE bool lastWriteResult() const { return m_writer->lastResult(); }
+
+    /**
+     * @brief Starts a configuration transaction. Modifications within a transaction are neither validated nor written
+     * until the outermost transaction is committed. Transactions can be nested.
+     */
+    void beginTransaction();
+
+    /**
+     * @brief Commits the transaction. The outermost commit validates the changed subtrees once and writes the
+     * configuration once. If the validation fails, all modifications of the transaction are rolled back.
+     * @return false if the validation failed or a nested transaction has been rolled back
+     */
+    bool commitTransaction();
+
+    /**
+     * @brief Rolls back all modifications since the outermost beginTransaction. Within a nested transaction the
+     * rollback is performed when the outermost transaction ends.
+     */
+    void rollbackTransaction();
+
+    bool inTransaction() const { return m_txDepth > 0; }
+
+    /**
+     * @brief Runs the action once the outermost transaction has been committed successfully, e.g. to update the
+     * loaded entities and integrations. The action is dropped if the transaction is rolled back. Outside of a
+     * transaction the action is run immediately.
+     */
+    void afterCommit(std::function<void()> action);
+
+    /**
+     * @brief Returns the configuration revision. It is incremented with every committed modification. The revision
+     * starts at a random value with every start of the application: a revision cached by a client before a restart
+     * doesn't match the configuration after it.
+     */
+    quint64 revision() const { return m_revision; }
+
+    /**
+     * @brief Synchronously writes pending configuration changes. Must be called before a shutdown or reboot.
+     * @return true if configuration could be successfully written
+     */
+    Q_INVOKABLE bool flush();
+
+    /**
+     * @brief Returns the counters of the configuration write-behind layer.
+     */
+    Q_INVOKABLE QVariantMap getWriteStatistics() { return m_writer->statistics(); }
+
     // get a QML object, you need to have objectName property of the QML object set to be able to use this
     QObject* getQMLObject(QList<QObject*> nodes, const QString& name);
     QObject* getQMLObject(const QString& name) override;
@@ -161,8 +226,17 @@ class Config : public QObject, public ConfigInterface {
     void configWriteError(const QString& error);
 
  private:
+    /**
+     * @brief Persists the configuration and only validates the given subtrees before writing.
+     * @param changedPaths JSON pointers of the changed subtrees. An empty list skips validation.
+     */
+    bool writeConfig(const QStringList& changedPaths);
+    bool validateSubtrees(const QVariantMap& config, const QStringList& paths);
+    void restoreTransactionBackup();
+    void runCommitActions();
     void syncConfigToCache();
     void syncCacheToConfig();
+    void applyPersistenceSettings();
 
     template <class EnumClass>
     QString enumToString(const EnumClass& enumKey) const {
@@ -188,9 +262,24 @@ class Config : public QObject, public ConfigInterface {
 
     // json configuration file
     JsonFile m_jsf;
+    // asynchronous configuration file writer
+    ConfigWriter* m_writer;
     // last read or write error message
     QString m_error;
 
+    // committed modifications, below 2^53 to be exact in JSON numbers
+    quint64 m_revision;
+
+    // transaction state
+    int         m_txDepth = 0;
+    QVariantMap m_txBackup;
+    QStringList m_txPaths;
+    bool        m_txDirty = false;
+    bool        m_txConfigChanged = false;
+    bool        m_txRollback = false;
+
+    QList<std::function<void()>> m_txActions;
+
     // Caches to improve performance
     QString          m_cacheProfileId;
     QVariantMap      m_cacheSettings;
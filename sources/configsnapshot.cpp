@@ -0,0 +1,108 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2020 Markus Zehnder <business@markuszehnder.ch>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+
+#include "configsnapshot.h"
+
+#include <QCborMap>
+#include <QCborValue>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QLoggingCategory>
+#include <QSaveFile>
+#include <QtDebug>
+
+static Q_LOGGING_CATEGORY(CLASS_LC, "config.snapshot");
+
+// increment if the snapshot format changes
+static const int SNAPSHOT_VERSION = 1;
+
+ConfigSnapshot::ConfigSnapshot(const QString &configFilePath, const QString &schemaFilePath)
+    : m_configPath(configFilePath), m_schemaPath(schemaFilePath) {
+    QFileInfo info(configFilePath);
+    m_snapshotPath = info.path() + "/" + info.completeBaseName() + ".cbor";
+}
+
+bool ConfigSnapshot::load(QVariantMap *config) const {
+    QFile file(m_snapshotPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QCborParserError error;
+    QCborValue       snapshot = QCborValue::fromCbor(file.readAll(), &error);
+    if (error.error != QCborError::NoError || !snapshot.isMap()) {
+        qCWarning(CLASS_LC) << "Ignoring invalid configuration snapshot:" << error.errorString();
+        return false;
+    }
+
+    if (snapshot["version"].toInteger() != SNAPSHOT_VERSION || snapshot["key"].toByteArray() != fingerprint()) {
+        qCDebug(CLASS_LC) << "Configuration snapshot is outdated:" << m_snapshotPath;
+        return false;
+    }
+
+    *config = snapshot["config"].toMap().toVariantMap();
+    return true;
+}
+
+bool ConfigSnapshot::save(const QVariantMap &config) const {
+    QCborMap snapshot;
+    snapshot.insert(QStringLiteral("version"), SNAPSHOT_VERSION);
+    snapshot.insert(QStringLiteral("key"), fingerprint());
+    snapshot.insert(QStringLiteral("config"), QCborMap::fromVariantMap(config));
+
+    QByteArray data = snapshot.toCborValue().toCbor();
+    QSaveFile  file(m_snapshotPath);
+    file.setDirectWriteFallback(true);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        qCWarning(CLASS_LC) << "Error writing configuration snapshot" << m_snapshotPath << ":" << file.errorString();
+        return false;
+    }
+
+    qCDebug(CLASS_LC) << "Configuration snapshot written:" << m_snapshotPath;
+    return true;
+}
+
+void ConfigSnapshot::remove() const { QFile::remove(m_snapshotPath); }
+
+QByteArray ConfigSnapshot::fingerprint() const {
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    for (const QString &path : {m_configPath, m_schemaPath}) {
+        QFileInfo info(path);
+        hash.addData(QString("%1:%2:%3;")
+                         .arg(path)
+                         .arg(info.size())
+                         .arg(info.lastModified().toMSecsSinceEpoch())
+                         .toUtf8());
+    }
+
+    // content hash: the modification time might not be reliable, e.g. after copying or on FAT file systems
+    QFile file(m_configPath);
+    if (file.open(QIODevice::ReadOnly)) {
+        hash.addData(&file);
+    }
+
+    return hash.result();
+}
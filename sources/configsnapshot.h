@@ -0,0 +1,73 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2020 Markus Zehnder <business@markuszehnder.ch>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QVariantMap>
+
+/**
+ * @brief ConfigSnapshot is a binary CBOR copy of the validated configuration file, stored next to it (config.cbor).
+ * The snapshot is keyed by the size, modification time and content hash of the configuration file and by the schema
+ * file it has been validated with. As long as both files are unchanged the configuration can be loaded from the
+ * snapshot without parsing and validating the JSON text.
+ */
+class ConfigSnapshot {
+ public:
+    ConfigSnapshot(const QString &configFilePath, const QString &schemaFilePath);
+
+    /**
+     * @brief Returns the full file name of the snapshot.
+     */
+    QString fileName() const { return m_snapshotPath; }
+
+    /**
+     * @brief Loads the configuration from the snapshot.
+     * @param config Returns the configuration
+     * @return false if there is no snapshot or it doesn't match the configuration or schema file anymore
+     */
+    bool load(QVariantMap *config) const;
+
+    /**
+     * @brief Writes the snapshot for the current configuration file. The given configuration must be the validated
+     * content of the configuration file.
+     * @return true if successful
+     */
+    bool save(const QVariantMap &config) const;
+
+    /**
+     * @brief Removes the snapshot. The next load reads the configuration file.
+     */
+    void remove() const;
+
+ private:
+    /**
+     * @brief Returns the key of the current configuration and schema file: size, modification time and SHA-1 hash.
+     */
+    QByteArray fingerprint() const;
+
+    QString m_configPath;
+    QString m_schemaPath;
+    QString m_snapshotPath;
+};
@@ -69,3 +69,70 @@ QVariant ConfigUtil::getValue(QJsonObject const& settings, QString const& path,
 
     return defaultValue;
 }
+
+QStringList ConfigUtil::jsonPointerTokens(QString const& pointer, bool* ok /* = nullptr */) {
+    if (ok) {
+        *ok = pointer.isEmpty() || pointer.startsWith('/');
+    }
+    if (pointer.isEmpty()) {
+        return QStringList();
+    }
+
+    QStringList tokens = pointer.mid(1).split('/');
+    for (QString& token : tokens) {
+        // order matters: "~01" must become "~1" and not "/"
+        token.replace("~1", "/");
+        token.replace("~0", "~");
+    }
+    return tokens;
+}
+
+QString ConfigUtil::jsonPointer(QStringList const& tokens) {
+    QString pointer;
+    for (QString token : tokens) {
+        pointer.append('/').append(token.replace('~', "~0").replace('/', "~1"));
+    }
+    return pointer;
+}
+
+QString ConfigUtil::jsonPointerParent(QString const& pointer) {
+    int index = pointer.lastIndexOf('/');
+    return index > 0 ? pointer.left(index) : QString();
+}
+
+QVariant ConfigUtil::getValueByPointer(QVariant const& root, QString const& pointer, bool* found /* = nullptr */) {
+    bool        ok;
+    QStringList tokens = jsonPointerTokens(pointer, &ok);
+    QVariant    current = root;
+
+    if (found) {
+        *found = false;
+    }
+    if (!ok) {
+        return QVariant();
+    }
+
+    for (QString const& token : tokens) {
+        if (current.type() == QVariant::Map) {
+            QVariantMap map = current.toMap();
+            if (!map.contains(token)) {
+                return QVariant();
+            }
+            current = map.value(token);
+        } else if (current.type() == QVariant::List || current.type() == QVariant::StringList) {
+            QVariantList list = current.toList();
+            int          index = token.toInt(&ok);
+            if (!ok || index < 0 || index >= list.size()) {
+                return QVariant();
+            }
+            current = list.at(index);
+        } else {
+            return QVariant();
+        }
+    }
+
+    if (found) {
+        *found = true;
+    }
+    return current;
+}
@@ -59,4 +59,31 @@ class ConfigUtil {
      */
     static QVariant getValue(QJsonObject const& settings, QString const& path,
                              QVariant const& defaultValue = QVariant());
+
+    /**
+     * @brief Splits a JSON pointer (RFC 6901) into its unescaped reference tokens.
+     * @param pointer JSON pointer, e.g. "/ui_config/profiles/abc". An empty pointer references the whole document.
+     * @param ok Set to false if the pointer is not empty and doesn't start with a "/"
+     * @return Reference tokens, empty for the whole document
+     */
+    static QStringList jsonPointerTokens(QString const& pointer, bool* ok = nullptr);
+
+    /**
+     * @brief Builds a JSON pointer (RFC 6901) from the given reference tokens, escaping "~" and "/".
+     */
+    static QString jsonPointer(QStringList const& tokens);
+
+    /**
+     * @brief Returns the JSON pointer of the parent of the given pointer. The parent of the document root is the root.
+     */
+    static QString jsonPointerParent(QString const& pointer);
+
+    /**
+     * @brief Retrieve the value referenced by a JSON pointer in a QVariantMap / QVariantList tree.
+     * @param root Configuration tree
+     * @param pointer JSON pointer, e.g. "/entities/light/0"
+     * @param found Set to true if the referenced value exists
+     * @return The referenced value or an invalid QVariant
+     */
+    static QVariant getValueByPointer(QVariant const& root, QString const& pointer, bool* found = nullptr);
 };
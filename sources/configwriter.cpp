@@ -0,0 +1,267 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2020 Markus Zehnder <business@markuszehnder.ch>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#include "configwriter.h"
+
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QLoggingCategory>
+#include <QtDebug>
+
+static Q_LOGGING_CATEGORY(CLASS_LC, "config.writer");
+
+ConfigWriter::ConfigWriter(const QString &configFilePath, const QString &schemaFilePath, int writeDelay,
+                           QObject *parent)
+    : QObject(parent), m_worker(new ConfigWriterThread(configFilePath, schemaFilePath)) {
+    m_timer.setSingleShot(true);
+    m_timer.setInterval(writeDelay);
+    connect(&m_timer, &QTimer::timeout, this, &ConfigWriter::onTimeout);
+
+    m_worker->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+    connect(this, &ConfigWriter::commitRequested, m_worker, &ConfigWriterThread::commit);
+    connect(m_worker, &ConfigWriterThread::committed, this, &ConfigWriter::onCommitted);
+    connect(this, &ConfigWriter::snapshotRequested, m_worker, &ConfigWriterThread::saveSnapshot);
+    connect(this, &ConfigWriter::validationRequested, m_worker, &ConfigWriterThread::validate);
+    connect(m_worker, &ConfigWriterThread::validated, this, &ConfigWriter::validated);
+
+    m_thread.setObjectName("ConfigWriter");
+    m_thread.start(QThread::LowPriority);
+}
+
+ConfigWriter::~ConfigWriter() {
+    flush();
+    m_thread.quit();
+    // nothing is left to write: only the event loop has to finish, destroying a running thread aborts the program
+    m_thread.wait();
+}
+
+void ConfigWriter::setWriteDelay(int msec) {
+    if (msec < 0) {
+        msec = 0;
+    }
+    m_timer.setInterval(msec);
+}
+
+void ConfigWriter::schedule(const QVariantMap &config, const QStringList &changedPaths) {
+    m_pending = config;
+    m_dirty   = true;
+    m_requested++;
+
+    // validating the whole document covers all subtrees
+    if (!m_pendingPaths.contains(QString())) {
+        if (changedPaths.contains(QString())) {
+            m_pendingPaths = QStringList(QString());
+        } else {
+            for (const QString &path : changedPaths) {
+                if (!m_pendingPaths.contains(path)) {
+                    m_pendingPaths.append(path);
+                }
+            }
+        }
+    }
+
+    // Don't restart an active timer: the coalescing window starts with the first change, otherwise a continuous
+    // stream of changes would never be written.
+    if (!m_timer.isActive() && !m_inFlight) {
+        m_timer.start();
+    }
+}
+
+bool ConfigWriter::flush() {
+    m_timer.stop();
+
+    if (!m_thread.isRunning()) {
+        return m_lastResult;
+    }
+
+    if (m_dirty) {
+        QVariantMap config = m_pending;
+        QStringList paths = m_pendingPaths;
+        m_pending.clear();
+        m_pendingPaths.clear();
+        m_dirty = false;
+
+        // blocking call: executed after an eventually in-flight commit
+        bool                success = false;
+        QString             error;
+        ConfigWriterThread *worker = m_worker;
+        QMetaObject::invokeMethod(m_worker,
+                                  [worker, &config, &paths, &success, &error]() {
+                                      success = worker->commitNow(config, paths, &error);
+                                  },
+                                  Qt::BlockingQueuedConnection);
+        m_lastResult = success;
+        m_lastError  = error;
+    } else if (m_inFlight) {
+        // nothing new to write: just wait for the in-flight commit and read its result
+        QMetaObject::invokeMethod(m_worker, "sync", Qt::BlockingQueuedConnection, Q_RETURN_ARG(bool, m_lastResult));
+    }
+    if (m_inFlight) {
+        // the committed signal of the in-flight commit is still queued: it must not overwrite the result
+        m_staleCommits++;
+        m_inFlight = false;
+    }
+
+    qCDebug(CLASS_LC) << "Configuration flushed:" << m_lastResult;
+    return m_lastResult;
+}
+
+void ConfigWriter::saveSnapshot(const QVariantMap &config) { emit snapshotRequested(config); }
+
+void ConfigWriter::validate(const QVariantMap &config) { emit validationRequested(config); }
+
+QVariantMap ConfigWriter::statistics() const {
+    QVariantMap stats = m_worker->statistics();
+    // every request which didn't result in its own commit has been coalesced
+    int avoided = static_cast<int>(m_requested) - stats.value("committed").toInt() - (isPending() ? 1 : 0);
+
+    stats.insert("requested", m_requested);
+    stats.insert("avoided", qMax(avoided, 0));
+    stats.insert("pending", isPending());
+    stats.insert("writeDelay", writeDelay());
+    stats.insert("lastResult", m_lastResult);
+    stats.insert("lastError", m_lastResult ? QString() : m_lastError);
+    return stats;
+}
+
+void ConfigWriter::onTimeout() {
+    if (m_inFlight) {
+        // coalesce into the next commit after the current one finished
+        return;
+    }
+    startCommit();
+}
+
+void ConfigWriter::onCommitted(bool success, const QString &error) {
+    if (m_staleCommits > 0) {
+        // flush already waited for this commit
+        m_staleCommits--;
+    } else {
+        m_inFlight   = false;
+        m_lastResult = success;
+        m_lastError  = error;
+    }
+
+    emit committed(success, error);
+
+    if (m_dirty && !m_timer.isActive()) {
+        m_timer.start();
+    }
+}
+
+void ConfigWriter::startCommit() {
+    if (!m_dirty) {
+        return;
+    }
+
+    QVariantMap config = m_pending;
+    QStringList paths  = m_pendingPaths;
+    m_pending.clear();
+    m_pendingPaths.clear();
+    m_dirty    = false;
+    m_inFlight = true;
+
+    emit commitRequested(config, paths);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// THREADED STUFF
+//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+ConfigWriterThread::ConfigWriterThread(const QString &configFilePath, const QString &schemaFilePath)
+    : m_jsf(new JsonFile(configFilePath, schemaFilePath, this)), m_snapshot(configFilePath, schemaFilePath) {}
+
+void ConfigWriterThread::commit(const QVariantMap &config, const QStringList &validationPaths) {
+    QString error;
+    bool    success = write(config, validationPaths, &error);
+
+    emit committed(success, error);
+}
+
+bool ConfigWriterThread::commitNow(const QVariantMap &config, const QStringList &validationPaths, QString *error) {
+    return write(config, validationPaths, error);
+}
+
+void ConfigWriterThread::saveSnapshot(const QVariantMap &config) { m_snapshot.save(config); }
+
+void ConfigWriterThread::validate(const QVariantMap &config) {
+    QElapsedTimer timer;
+    timer.start();
+
+    QString error;
+    bool    valid = m_jsf->validate(QJsonDocument::fromVariant(config), error);
+    if (valid) {
+        qCDebug(CLASS_LC) << "Configuration validated in" << timer.elapsed() << "ms";
+    } else {
+        qCWarning(CLASS_LC) << "Configuration validation failed, removing snapshot:" << error;
+        m_snapshot.remove();
+    }
+
+    emit validated(valid, error);
+}
+
+bool ConfigWriterThread::write(const QVariantMap &config, const QStringList &validationPaths, QString *error) {
+    QElapsedTimer timer;
+    timer.start();
+
+    bool   success = m_jsf->write(config, validationPaths);
+    qint64 elapsed = timer.elapsed();
+
+    QMutexLocker locker(&m_statsMutex);
+    m_commits++;
+    m_lastLatency = elapsed;
+    m_totalLatency += elapsed;
+    if (elapsed > m_maxLatency) {
+        m_maxLatency = elapsed;
+    }
+
+    if (success) {
+        qCDebug(CLASS_LC) << "Configuration committed in" << elapsed << "ms";
+    } else {
+        m_failures++;
+        qCWarning(CLASS_LC) << "Failed to commit configuration:" << m_jsf->error();
+        if (error) {
+            *error = m_jsf->error();
+        }
+    }
+
+    locker.unlock();
+
+    m_lastResult = success;
+    if (success) {
+        m_snapshot.save(config);
+    }
+    return success;
+}
+
+QVariantMap ConfigWriterThread::statistics() const {
+    QMutexLocker locker(&m_statsMutex);
+
+    QVariantMap stats;
+    stats.insert("committed", m_commits);
+    stats.insert("failed", m_failures);
+    stats.insert("lastLatency", m_lastLatency);
+    stats.insert("maxLatency", m_maxLatency);
+    stats.insert("avgLatency", m_commits > 0 ? m_totalLatency / m_commits : 0);
+    return stats;
+}
@@ -0,0 +1,203 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2020 Markus Zehnder <business@markuszehnder.ch>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+#pragma once
+
+#include <QMutex>
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+#include <QVariantMap>
+
+#include "configsnapshot.h"
+#include "jsonfile.h"
+
+class ConfigWriterThread;
+
+/**
+ * @brief ConfigWriter is a write-behind layer for the configuration file.
+ * Write requests are coalesced within a configurable delay and committed on a background thread: the configuration is
+ * serialized and validated in the worker thread and atomically replaces the existing file (temp file, fsync, rename).
+ * Only one commit is in flight at any time, requests arriving meanwhile are coalesced into the next commit.
+ * After each commit the binary configuration snapshot is updated.
+ */
+class ConfigWriter : public QObject {
+    Q_OBJECT
+
+ public:
+    /**
+     * @param configFilePath The configuration file to write
+     * @param schemaFilePath The JSON schema to validate the configuration against before writing
+     * @param writeDelay Coalescing window in milliseconds. 0 commits with the next event loop iteration.
+     */
+    explicit ConfigWriter(const QString &configFilePath, const QString &schemaFilePath, int writeDelay = 1000,
+                          QObject *parent = nullptr);
+    ~ConfigWriter() override;
+
+    int  writeDelay() const { return m_timer.interval(); }
+    void setWriteDelay(int msec);
+
+    /**
+     * @brief Schedules the given configuration to be persisted. Any pending, not yet committed configuration is
+     * replaced.
+     * @param config The complete configuration
+     * @param changedPaths JSON pointers of the changed subtrees which have to be validated before writing. The changed
+     * paths of coalesced requests are accumulated. An empty pointer validates the whole configuration.
+     */
+    void schedule(const QVariantMap &config, const QStringList &changedPaths = QStringList(QString()));
+
+    /**
+     * @brief Synchronously persists a pending configuration and waits for an in-flight commit to finish.
+     * Intended for shutdown and reboot paths.
+     * @return false if the last commit failed
+     */
+    bool flush();
+
+    /**
+     * @brief Writes the binary snapshot of the configuration file in the background.
+     * @param config The validated content of the configuration file
+     */
+    void saveSnapshot(const QVariantMap &config);
+
+    /**
+     * @brief Validates the configuration in the background. The snapshot is removed if the validation fails.
+     * The result is reported with the validated signal.
+     */
+    void validate(const QVariantMap &config);
+
+    /**
+     * @brief Returns true if a configuration is waiting to be committed or a commit is in progress.
+     */
+    bool isPending() const { return m_dirty || m_inFlight; }
+
+    /**
+     * @brief Returns the write counters: requested & committed writes, writes avoided by coalescing, failed commits,
+     * commit latency (last, average, maximum) in milliseconds and the result of the last commit.
+     */
+    QVariantMap statistics() const;
+
+    /**
+     * @brief Returns false if the last commit failed. Asynchronous commits report their result later than the write
+     * request: check after flush or on the committed signal.
+     */
+    bool lastResult() const { return m_lastResult; }
+
+ signals:
+    /**
+     * @brief Emitted after an asynchronous commit finished.
+     * @param success true if the configuration has been written
+     * @param error Error message if the commit failed
+     */
+    void committed(bool success, const QString &error);
+
+    /**
+     * @brief Internal signal to queue a commit in the worker thread.
+     */
+    void commitRequested(const QVariantMap &config, const QStringList &validationPaths);
+
+    /**
+     * @brief Emitted after a background validation finished.
+     * @param valid true if the configuration is valid
+     * @param error Validation error message
+     */
+    void validated(bool valid, const QString &error);
+
+    // internal signals for the worker thread
+    void snapshotRequested(const QVariantMap &config);
+    void validationRequested(const QVariantMap &config);
+
+ private slots:  // NOLINT open issue: https://github.com/cpplint/cpplint/pull/99
+    void onTimeout();
+    void onCommitted(bool success, const QString &error);
+
+ private:
+    void startCommit();
+
+    QThread             m_thread;
+    ConfigWriterThread *m_worker;
+    QTimer              m_timer;
+
+    QVariantMap m_pending;
+    QStringList m_pendingPaths;
+    bool        m_dirty        = false;
+    bool        m_inFlight     = false;
+    bool        m_lastResult   = true;
+    QString     m_lastError;
+    quint32     m_requested    = 0;
+    int         m_staleCommits = 0;  // committed signals of commits flush already waited for
+};
+
+/**
+ * @brief Worker object living in the ConfigWriter thread. Performs the actual serialization, validation and commit.
+ */
+class ConfigWriterThread : public QObject {
+    Q_OBJECT
+
+ public:
+    ConfigWriterThread(const QString &configFilePath, const QString &schemaFilePath);
+
+    QVariantMap statistics() const;
+
+ signals:
+    void committed(bool success, const QString &error);
+    void validated(bool valid, const QString &error);
+
+ public slots:  // NOLINT open issue: https://github.com/cpplint/cpplint/pull/99
+    /**
+     * @brief Commits the configuration and emits committed.
+     */
+    void commit(const QVariantMap &config, const QStringList &validationPaths);
+
+    /**
+     * @brief Commits the configuration without emitting committed. Used for blocking calls.
+     * @param error Error message if the commit failed
+     * @return true if successful
+     */
+    bool commitNow(const QVariantMap &config, const QStringList &validationPaths, QString *error);
+
+    void saveSnapshot(const QVariantMap &config);
+
+    /**
+     * @brief Validates the whole configuration and emits validated.
+     */
+    void validate(const QVariantMap &config);
+
+    /**
+     * @brief A blocking call returns after all previously queued commits have been processed.
+     * @return the result of the last commit
+     */
+    bool sync() { return m_lastResult; }
+
+ private:
+    bool write(const QVariantMap &config, const QStringList &validationPaths, QString *error);
+
+    JsonFile *     m_jsf;
+    ConfigSnapshot m_snapshot;
+    bool           m_lastResult = true;
+
+    mutable QMutex m_statsMutex;
+    quint32        m_commits      = 0;
+    quint32        m_failures     = 0;
+    qint64         m_lastLatency  = 0;
+    qint64         m_maxLatency   = 0;
+    qint64         m_totalLatency = 0;
+};
@@ -45,6 +45,9 @@ bool Blind::updateAttrByIndex(int attrIndex, const QVariant& value) {
             }
             break;
     }
+    if (chg) {
+        emit attributeChanged(attrIndex);
+    }
     return chg;
 }
 
@@ -56,6 +59,10 @@ void Blind::stop() { command(BlindDef::C_STOP, ""); }
 
 void Blind::setPosition(int value) { command(BlindDef::C_POSITION, value); }
 
+int Blind::defaultCommandRateLimit(int command) const {
+    return command == BlindDef::C_POSITION ? SLIDER_RATE_LIMIT : 0;
+}
+
 Blind::Blind(const QVariantMap& config, IntegrationInterface* integrationObj, QObject* parent)
     : Entity(Type, config, integrationObj, parent), m_position(0) {
     static QMetaEnum metaEnumAttr;
@@ -55,6 +55,9 @@ class Blind : public Entity, BlindInterface {
 
     Blind(const QVariantMap& config, IntegrationInterface* integrationObj, QObject* parent = nullptr);
 
+ protected:
+    int defaultCommandRateLimit(int command) const override;
+
  signals:
     void positionChanged();
 
@@ -30,6 +30,10 @@ ClimateInterface::~ClimateInterface() {}
 
 void Climate::setTargetTemperature(int temp) { command(ClimateDef::C_TARGET_TEMPERATURE, temp); }
 
+int Climate::defaultCommandRateLimit(int command) const {
+    return command == ClimateDef::C_TARGET_TEMPERATURE ? SLIDER_RATE_LIMIT : 0;
+}
+
 void Climate::heat() { command(ClimateDef::C_HEAT, ""); }
 
 void Climate::cool() { command(ClimateDef::C_COOL, ""); }
@@ -79,6 +83,9 @@ bool Climate::updateAttrByIndex(int attrIndex, const QVariant &value) {
             }
             break;
     }
+    if (chg) {
+        emit attributeChanged(attrIndex);
+    }
     return chg;
 }
 
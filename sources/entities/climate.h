@@ -64,6 +64,9 @@ class Climate : public Entity, ClimateInterface {
 
     explicit Climate(const QVariantMap& config, IntegrationInterface* integrationObj, QObject* parent = nullptr);
 
+ protected:
+    int defaultCommandRateLimit(int command) const override;
+
  signals:
     void temperatureChanged();
     void targetTemperatureChanged();
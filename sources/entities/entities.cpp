@@ -71,7 +71,7 @@ void Entities::load() {
 
     for (int i = 0; i < m_supportedEntities.length(); i++) {
         if (entities.contains(m_supportedEntities[i])) {
-            QVariantList type = entities.value(m_supportedEntities[i]).toJsonArray().toVariantList();
+            QVariantList type = entities.value(m_supportedEntities[i]).toList();
 
             for (int k = 0; k < type.length(); k++) {
                 QVariantMap           map = type[k].toMap();
@@ -84,11 +84,17 @@ void Entities::load() {
     emit entitiesLoaded();
 
     // when all entities are loaded, connect the integrations
-    QList<QObject *> integrations = Integrations::getInstance()->list();
-    for (int i = 0; i < integrations.count(); i++) {
-        QObject *             obj = integrations[i];
-        IntegrationInterface *ii  = qobject_cast<IntegrationInterface *>(obj);
-        ii->connect();
+    Integrations::getInstance()->reconnectScheduler()->connectAll();
+}
+
+void Entities::bindIntegration(const QString &integrationId, IntegrationInterface *integrationObj) {
+    for (Entity *entity : qAsConst(m_entities)) {
+        if (entity->integration() == integrationId) {
+            entity->setIntegrationObj(integrationObj);
+        }
+    }
+    if (integrationObj) {
+        Integrations::getInstance()->reconnectScheduler()->connectIntegration(integrationId);
     }
 }
 
@@ -138,6 +144,7 @@ void Entities::setConnected(const QString &integrationId, bool connected) {
             i.value()->setConnected(connected);
         }
     }
+    emit integrationConnectionChanged(integrationId, connected);
 }
 
 bool Entities::isSupportedEntityType(const QString &type) {
@@ -190,6 +197,8 @@ void Entities::add(const QString &type, const QVariantMap &config, IntegrationIn
     } else {
         if (!m_entities.contains(entity->entity_id())) {
             m_entities.insert(entity->entity_id(), entity);
+            connect(entity, &Entity::attributeChanged, this,
+                    [this, entity](int attrIndex) { emit entityChanged(entity, attrIndex); });
             qCDebug(CLASS_LC) << "Entity added to entity registry:" << entity->entity_id();
         }
     }
@@ -66,6 +66,9 @@ class Entities : public QObject, public EntitiesInterface {
     // remove an entity
     void remove(const QString& entity_id);
 
+    // bind the entities of an integration to a new instance and connect it, nullptr unbinds the entities
+    void bindIntegration(const QString& integrationId, IntegrationInterface* integrationObj);
+
     // get entites by type
     QList<EntityInterface*> getByType(const QString& type) override;
 
@@ -78,6 +81,9 @@ class Entities : public QObject, public EntitiesInterface {
     // get entities by integration
     QList<EntityInterface*> getByIntegration(const QString& integration) override;
 
+    // all entities sorted by entity_id
+    const QMap<QString, Entity*>& entities() const { return m_entities; }
+
     // get entity interface
     EntityInterface* getEntityInterface(const QString& entity_id) override;
 
@@ -103,6 +109,10 @@ class Entities : public QObject, public EntitiesInterface {
  signals:
     void mediaplayersPlayingChanged();
     void entitiesLoaded();
+    // the entities of an integration have been set connected or disconnected by the integration
+    void integrationConnectionChanged(const QString& integrationId, bool connected);
+    // an attribute of a registered entity changed
+    void entityChanged(Entity* entity, int attrIndex);
 
  private:
     QMap<QString, Entity*> m_entities;
@@ -22,9 +22,20 @@
 
 #include "entity.h"
 
+#include <QColor>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QLoggingCategory>
+#include <QMetaProperty>
+#include <QMutex>
 #include <QTimer>
 
 #include "../config.h"
+#include "../configutil.h"
+#include "../integrations/integrations.h"
+#include "../integrations/integrationthreads.h"
+
+static Q_LOGGING_CATEGORY(CLASS_LC, "entity");
 
 EntityInterface::~EntityInterface() {}
 
@@ -54,9 +65,100 @@ Entity::Entity(const QString& type, const QVariantMap& config, IntegrationInterf
 
 Entity::~Entity() {}
 
+static qint64 monotonicMsecs() {
+    static QElapsedTimer clock;
+    if (!clock.isValid()) {
+        clock.start();
+    }
+    return clock.elapsed();
+}
+
 void Entity::command(int command, const QVariant& param) {
-    if (m_integrationObj)
-        m_integrationObj->sendCommand(m_type, entity_id(), command, param);
+    int rateLimit = commandRateLimit(command);
+    if (rateLimit > 0) {
+        CoalescedCommand& coalesced = m_coalesced[command];
+        qint64            now       = monotonicMsecs();
+        if (coalesced.lastSent >= 0 && now - coalesced.lastSent < rateLimit) {
+            if (coalesced.dueAt >= 0) {
+                // the pending value is replaced without being sent
+                CommandQueue* queue = Integrations::getInstance()->commandQueue(m_integration);
+                if (queue) {
+                    queue->recordSuppressed(m_type + '.' + getCommandName(command));
+                }
+            }
+            coalesced.param = param;
+            coalesced.dueAt = coalesced.lastSent + rateLimit;
+
+            if (!m_coalesceTimer) {
+                m_coalesceTimer = new QTimer(this);
+                m_coalesceTimer->setSingleShot(true);
+                connect(m_coalesceTimer, &QTimer::timeout, this, &Entity::onCoalesceTimer);
+            }
+            if (!m_coalesceTimer->isActive() || m_coalesceTimer->remainingTime() > coalesced.dueAt - now) {
+                m_coalesceTimer->start(static_cast<int>(coalesced.dueAt - now));
+            }
+            return;
+        }
+        coalesced.lastSent = now;
+        coalesced.dueAt    = -1;
+    }
+    sendCommand(command, param);
+}
+
+void Entity::sendCommand(int command, const QVariant& param) {
+    // held by the queue while the integration is disconnected
+    CommandQueue* queue = Integrations::getInstance()->commandQueue(m_integration);
+    if (queue) {
+        queue->send(m_type, entity_id(), command, param, commandLane(command));
+    } else if (m_integrationObj) {
+        // the integration hasn't been added yet, e.g. still loading after the load timeout
+        QString entityId = entity_id();
+        QString type     = m_type;
+        IntegrationThreads::post(m_integrationObj, [type, entityId, command, param](IntegrationInterface* integration) {
+            integration->sendCommand(type, entityId, command, param);
+        });
+    } else {
+        qCWarning(CLASS_LC) << "Dropping command" << getCommandName(command) << "for" << entity_id()
+                            << ": integration not loaded:" << m_integration;
+    }
+}
+
+void Entity::onCoalesceTimer() {
+    qint64 now  = monotonicMsecs();
+    qint64 next = -1;
+
+    for (auto iter = m_coalesced.begin(); iter != m_coalesced.end(); ++iter) {
+        CoalescedCommand& coalesced = iter.value();
+        if (coalesced.dueAt < 0) {
+            continue;
+        } else if (coalesced.dueAt <= now) {
+            // trailing send of the last value
+            coalesced.lastSent = now;
+            coalesced.dueAt    = -1;
+            sendCommand(iter.key(), coalesced.param);
+        } else if (next < 0 || coalesced.dueAt < next) {
+            next = coalesced.dueAt;
+        }
+    }
+    if (next >= 0) {
+        m_coalesceTimer->start(static_cast<int>(next - now));
+    }
+}
+
+int Entity::commandRateLimit(int command) {
+    QVariant rateLimit = ConfigUtil::getValue(Config::getInstance()->getSettings(),
+                                              "commands/rate_limits/" + m_type + '.' + getCommandName(command));
+    return rateLimit.isValid() ? rateLimit.toInt() : defaultCommandRateLimit(command);
+}
+
+int Entity::defaultCommandRateLimit(int command) const {
+    Q_UNUSED(command)
+    return 0;
+}
+
+CommandQueue::Lane Entity::commandLane(int command) const {
+    Q_UNUSED(command)
+    return CommandQueue::USER;
 }
 
 bool Entity::update(const QVariantMap& attributes) {
@@ -67,6 +169,34 @@ bool Entity::update(const QVariantMap& attributes) {
     }
     return chg;
 }
+
+bool Entity::updateConfig(const QVariantMap& config) {
+    if (config.value(Config::KEY_INTEGRATION).toString() != m_integration) {
+        return false;
+    }
+
+    QString friendlyName = config.value(Config::KEY_FRIENDLYNAME).toString();
+    if (m_friendly_name != friendlyName) {
+        m_friendly_name = friendlyName;
+        emit friendlyNameChanged();
+    }
+
+    QString area = config.value(Config::KEY_AREA).toString();
+    if (m_area != area) {
+        m_area = area;
+        emit areaChanged();
+    }
+
+    QStringList features = supported_features();
+    memset(m_supported_features, 0, sizeof(m_supported_features));
+    initializeSupportedFeatures(config);
+    if (features != supported_features()) {
+        emit supportedFeaturesChanged();
+    }
+
+    return true;
+}
+
 bool Entity::updateAttrByName(const QString& name, const QVariant& value) {
     int attrIndex = getAttrIndex(name);
     return updateAttrByIndex(attrIndex, value);
@@ -79,6 +209,54 @@ int Entity::getAttrIndex(const QString& attrName) {
     Q_ASSERT(m_enumAttr != nullptr);
     return m_enumAttr->keyToValue(attrName.toUpper().toUtf8());
 }
+QVariant Entity::getAttrValue(int attrIndex) {
+    Q_ASSERT(m_enumAttr != nullptr);
+    const char* key = m_enumAttr->valueToKey(attrIndex);
+    if (key == nullptr) {
+        return QVariant();
+    }
+    if (qstrcmp(key, "STATE") == 0) {
+        return stateText();
+    }
+
+    // attribute to property index per entity class, e.g. TARGET_TEMPERATURE -> targetTemperature
+    static QMutex                                     s_mutex;
+    static QHash<const QMetaObject*, QHash<int, int>> s_properties;
+
+    const QMetaObject* meta = metaObject();
+    int                propertyIndex;
+    {
+        QMutexLocker     locker(&s_mutex);
+        QHash<int, int>& properties = s_properties[meta];
+        auto             iter       = properties.constFind(attrIndex);
+        if (iter == properties.constEnd()) {
+            QString name  = QString(key).remove('_');
+            propertyIndex = -1;
+            for (int i = 0; i < meta->propertyCount(); i++) {
+                if (name.compare(meta->property(i).name(), Qt::CaseInsensitive) == 0) {
+                    propertyIndex = i;
+                    break;
+                }
+            }
+            iter = properties.insert(attrIndex, propertyIndex);
+        }
+        propertyIndex = iter.value();
+    }
+    if (propertyIndex < 0) {
+        return QVariant();
+    }
+
+    QVariant value = meta->property(propertyIndex).read(this);
+    switch (static_cast<int>(value.type())) {
+        case QMetaType::QColor:
+            return value.value<QColor>().name();
+        case QMetaType::QObjectStar:
+            // complex attributes like the weather forecast are not available as a plain value
+            return QVariant();
+        default:
+            return value;
+    }
+}
 QString Entity::getFeatureName(int featureIndex) {
     Q_ASSERT(m_enumFeatures != nullptr);
     return QString(m_enumFeatures->valueToKey(featureIndex)).mid(2);
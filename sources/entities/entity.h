@@ -21,11 +21,14 @@
  *****************************************************************************/
 #pragma once
 
+#include <QHash>
 #include <QObject>
 #include <QString>
 #include <QStringList>
+#include <QTimer>
 #include <QVariant>
 
+#include "../integrations/commandqueue.h"
 #include "yio-interface/entities/entityinterface.h"
 #include "yio-interface/integrationinterface.h"
 
@@ -42,14 +45,14 @@ class Entity : public QObject, EntityInterface {
     static const int MAX_FEATURES = 96;  // Maximum number of features, must be increased if too small
 
     Q_PROPERTY(QString type READ type CONSTANT)
-    Q_PROPERTY(QString friendly_name READ friendly_name CONSTANT)
+    Q_PROPERTY(QString friendly_name READ friendly_name NOTIFY friendlyNameChanged)
     Q_PROPERTY(QString entity_id READ entity_id CONSTANT)
-    Q_PROPERTY(QString area READ area CONSTANT)
+    Q_PROPERTY(QString area READ area NOTIFY areaChanged)
     Q_PROPERTY(QString integration READ integration CONSTANT)
     Q_PROPERTY(bool favorite READ favorite WRITE setFavorite NOTIFY favoriteChanged)
     Q_PROPERTY(bool connected READ connected WRITE setConnected NOTIFY connectedChanged)
-    Q_PROPERTY(
-        QStringList supported_features READ supported_features CONSTANT)  // !!!!! use isSupported if possible !!!!!!!
+    Q_PROPERTY(QStringList supported_features READ supported_features NOTIFY
+                   supportedFeaturesChanged)  // !!!!! use isSupported if possible !!!!!!!
 
     Q_PROPERTY(int state READ state WRITE setState NOTIFY stateChanged)
     Q_PROPERTY(QString stateText READ stateText WRITE setStateText NOTIFY stateTextChanged)
@@ -62,6 +65,14 @@ class Entity : public QObject, EntityInterface {
 
     // send command to the integration
     Q_INVOKABLE void command(int command, const QVariant& param);  // Use Command enum C_XXXX
+
+    // queue lane of a command: user interaction unless overridden for background traffic
+    virtual CommandQueue::Lane commandLane(int command) const;
+
+    // minimum interval in ms between two sends of a command, 0 sends every value. The setting
+    // commands/rate_limits/<entity type>.<COMMAND> overrides the default of the entity.
+    int commandRateLimit(int command);
+
     Q_INVOKABLE void turnOn() {}
     Q_INVOKABLE void turnOff() {}
 
@@ -70,12 +81,20 @@ class Entity : public QObject, EntityInterface {
 
     // update an entity with attributes from integration hub, return true in case of change
     Q_INVOKABLE bool update(const QVariantMap& attributes);
+
+    /**
+     * @brief Updates the entity in place with a changed entity configuration from config.json.
+     * @return false if the entity cannot be updated in place and must be recreated: entity type or integration changed
+     */
+    virtual bool updateConfig(const QVariantMap& config);
     Q_INVOKABLE bool updateAttrByName(const QString& name, const QVariant& value);
     Q_INVOKABLE bool updateAttrByIndex(int attrIndex, const QVariant& value);  // must be overriden
 
     // Attribute name and index
     Q_INVOKABLE QString getAttrName(int attrIndex);
     Q_INVOKABLE int     getAttrIndex(const QString& attrName);
+    // current attribute value, read from the property with the same name. STATE returns the state text.
+    Q_INVOKABLE QVariant getAttrValue(int attrIndex);
 
     // Feature name and index
     Q_INVOKABLE QString getFeatureName(int featureIndex);
@@ -93,6 +112,7 @@ class Entity : public QObject, EntityInterface {
     QString               entity_id() { return objectName(); }
     QString               integration() { return m_integration; }
     IntegrationInterface* integrationObj() { return m_integrationObj; }
+    void                  setIntegrationObj(IntegrationInterface* integrationObj) { m_integrationObj = integrationObj; }
     QStringList           supported_features();
     bool                  favorite() { return m_favorite; }
     void                  setFavorite(bool value);
@@ -115,11 +135,21 @@ class Entity : public QObject, EntityInterface {
     void onChanged();
     void stateTextChanged();
     void connectedChanged();
+    void friendlyNameChanged();
+    void areaChanged();
+    void supportedFeaturesChanged();
+    // emitted by updateAttrByIndex if the attribute value changed
+    void attributeChanged(int attrIndex);
 
  protected:
     void initializeSupportedFeatures(
         const QVariantMap& config);  // !!!! must be called in every concrete entity constructor !!!!
 
+    // rate limit of slider driven commands like brightness or volume, 0 for all others
+    virtual int defaultCommandRateLimit(int command) const;
+
+    static const int SLIDER_RATE_LIMIT = 250;
+
     IntegrationInterface* m_integrationObj;
     QString               m_type;
     QString               m_area;
@@ -134,4 +164,19 @@ class Entity : public QObject, EntityInterface {
     QMetaEnum*            m_enumFeatures;
     QMetaEnum*            m_enumCommands;
     void*                 m_specificInterface;
+
+ private:
+    // latest value wins: values arriving within the rate limit replace each other, the last one is sent when the
+    // interval is over
+    struct CoalescedCommand {
+        qint64   lastSent = -1;
+        qint64   dueAt = -1;  // pending trailing send
+        QVariant param;
+    };
+
+    void sendCommand(int command, const QVariant& param);
+    void onCoalesceTimer();
+
+    QHash<int, CoalescedCommand> m_coalesced;
+    QTimer*                      m_coalesceTimer = nullptr;
 };
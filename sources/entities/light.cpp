@@ -65,6 +65,9 @@ bool Light::updateAttrByIndex(int attrIndex, const QVariant& value) {
             }
             break;
     }
+    if (chg) {
+        emit attributeChanged(attrIndex);
+    }
     return chg;
 }
 
@@ -84,6 +87,17 @@ void Light::setColor(QColor value) { command(LightDef::C_COLOR, QVariant(value))
 
 void Light::setColorTemp(int value) { command(LightDef::C_COLORTEMP, value); }
 
+int Light::defaultCommandRateLimit(int command) const {
+    switch (command) {
+        case LightDef::C_BRIGHTNESS:
+        case LightDef::C_COLOR:
+        case LightDef::C_COLORTEMP:
+            return SLIDER_RATE_LIMIT;
+        default:
+            return 0;
+    }
+}
+
 Light::Light(const QVariantMap& config, IntegrationInterface* integrationObj, QObject* parent)
     : Entity(Type, config, integrationObj, parent), m_brightness(0), m_colorTemp(0) {
     static QMetaEnum metaEnumAttr;
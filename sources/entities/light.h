@@ -56,6 +56,9 @@ class Light : public Entity, LightInterface {
 
     explicit Light(const QVariantMap& config, IntegrationInterface* integrationObj, QObject* parent = nullptr);
 
+ protected:
+    int defaultCommandRateLimit(int command) const override;
+
  signals:
     void brightnessChanged();
     void colorChanged();
@@ -108,6 +108,9 @@ bool MediaPlayer::updateAttrByIndex(int attrIndex, const QVariant &value) {
             }
             break;
     }
+    if (chg) {
+        emit attributeChanged(attrIndex);
+    }
     return chg;
 }
 
@@ -138,6 +141,23 @@ bool MediaPlayer::supportsOn() {
         return false;
     }
 }
+CommandQueue::Lane MediaPlayer::commandLane(int command) const {
+    switch (command) {
+        case MediaPlayerDef::C_BROWSE:
+        case MediaPlayerDef::C_SEARCH:
+        case MediaPlayerDef::C_SEARCH_ITEM:
+        case MediaPlayerDef::C_GETALBUM:
+        case MediaPlayerDef::C_GETPLAYLIST:
+            return CommandQueue::BACKGROUND;
+        default:
+            return CommandQueue::USER;
+    }
+}
+
+int MediaPlayer::defaultCommandRateLimit(int command) const {
+    return command == MediaPlayerDef::C_VOLUME_SET ? SLIDER_RATE_LIMIT : 0;
+}
+
 // extension for "generic" media browsing
 void MediaPlayer::browse(QString cmd) { command(MediaPlayerDef::C_BROWSE, cmd); }
 void MediaPlayer::playMedia(const QString &itemKey, const QString &type) {
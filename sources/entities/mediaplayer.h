@@ -82,6 +82,14 @@ class MediaPlayer : public Entity, MediaPlayerInterface {
     void turnOn() override;
     void turnOff() override;
 
+    // browsing and searching are background traffic
+    CommandQueue::Lane commandLane(int command) const override;
+
+ protected:
+    int defaultCommandRateLimit(int command) const override;
+
+ public:
+
     // extension for media browsing
     Q_INVOKABLE void browse(QString command);  // Command item_key, "TOP", "BACK", "PLAY"
     Q_INVOKABLE void playMedia(const QString& itemKey, const QString& type);
@@ -200,9 +200,28 @@ Remote::Remote(const QVariantMap& config, IntegrationInterface* integrationObj,
 
     m_specificInterface = qobject_cast<RemoteInterface*>(this);
     initializeSupportedFeatures(config);
-    m_commands = config.value("commands").toJsonArray().toVariantList();
+    m_commands = config.value("commands").toList();
     m_settings = config.value("settings").toMap();
     m_channels = config.value("channels").toList();
     emit commandsChanged();
     emit channelsChanged();
 }
+
+bool Remote::updateConfig(const QVariantMap& config) {
+    if (!Entity::updateConfig(config)) {
+        return false;
+    }
+
+    QVariantList commands = config.value("commands").toList();
+    QVariantList channels = config.value("channels").toList();
+    m_settings            = config.value("settings").toMap();
+    if (m_commands != commands) {
+        m_commands = commands;
+        emit commandsChanged();
+    }
+    if (m_channels != channels) {
+        m_channels = channels;
+        emit channelsChanged();
+    }
+    return true;
+}
@@ -92,6 +92,8 @@ class Remote : public Entity, RemoteInterface {
     bool supportsOn() override;
     bool isOn() override;
 
+    bool updateConfig(const QVariantMap& config) override;
+
     explicit Remote(QObject* parent = nullptr);
     Remote(const QVariantMap& config, IntegrationInterface* integrationObj, QObject* parent = nullptr);
 
@@ -45,6 +45,9 @@ bool Switch::updateAttrByIndex(int attrIndex, const QVariant& value) {
             }
             break;
     }
+    if (chg) {
+        emit attributeChanged(attrIndex);
+    }
     return chg;
 }
 
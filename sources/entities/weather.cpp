@@ -52,6 +52,9 @@ bool Weather::updateAttrByIndex(int attrIndex, const QVariant& value) {
         default:
             break;
     }
+    if (chg) {
+        emit attributeChanged(attrIndex);
+    }
     return chg;
 }
 
@@ -0,0 +1,75 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2020 Markus Zehnder <business@markuszehnder.ch>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+
+#include "frametimemonitor.h"
+
+#include <QLoggingCategory>
+#include <QScreen>
+#include <QtDebug>
+
+static Q_LOGGING_CATEGORY(CLASS_LC, "frametime");
+
+FrameTimeMonitor *FrameTimeMonitor::s_instance = nullptr;
+
+FrameTimeMonitor::FrameTimeMonitor(QQuickWindow *window, QObject *parent) : QObject(parent), m_window(window) {
+    s_instance = this;
+
+    if (m_window->screen() && m_window->screen()->refreshRate() > 0) {
+        m_refreshPeriod = static_cast<qint64>(1000000 / m_window->screen()->refreshRate());
+    }
+
+    // afterAnimating is emitted in the GUI thread for every frame, before the scene graph is synchronized
+    connect(m_window, &QQuickWindow::afterAnimating, this, &FrameTimeMonitor::onFrame);
+    m_timer.start();
+
+    qCDebug(CLASS_LC) << "Monitoring frame time, refresh period:" << m_refreshPeriod << "us";
+}
+
+FrameTimeMonitor::~FrameTimeMonitor() { s_instance = nullptr; }
+
+QVariantMap FrameTimeMonitor::statistics() const {
+    QVariantMap stats = m_frameTime.toVariantMap();
+    stats.insert("dropped", m_droppedFrames);
+    stats.insert("refresh_period", m_refreshPeriod);
+    return stats;
+}
+
+void FrameTimeMonitor::reset() {
+    m_frameTime.reset();
+    m_droppedFrames = 0;
+    m_lastFrame     = -1;
+}
+
+void FrameTimeMonitor::onFrame() {
+    qint64 now = m_timer.nsecsElapsed() / 1000;
+    if (m_lastFrame >= 0) {
+        qint64 interval = now - m_lastFrame;
+        if (interval < IDLE_INTERVAL) {
+            m_frameTime.record(interval);
+            if (interval * 2 > m_refreshPeriod * 3) {
+                m_droppedFrames++;
+            }
+        }
+    }
+    m_lastFrame = now;
+}
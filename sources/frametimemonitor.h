@@ -0,0 +1,67 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2020 Markus Zehnder <business@markuszehnder.ch>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QQuickWindow>
+#include <QVariantMap>
+
+#include "latencyhistogram.h"
+
+/**
+ * @brief FrameTimeMonitor measures the GUI frame time of a window: the interval between two consecutive frames while
+ * the scene is animating. A frame interval exceeding 1.5 refresh periods is counted as dropped frame. Intervals longer
+ * than a second are considered as idle scene and not recorded.
+ * Used to measure the impact of background load, e.g. an API load test, on the QML animations.
+ */
+class FrameTimeMonitor : public QObject {
+    Q_OBJECT
+
+ public:
+    explicit FrameTimeMonitor(QQuickWindow* window, QObject* parent = nullptr);
+    ~FrameTimeMonitor() override;
+
+    static FrameTimeMonitor* getInstance() { return s_instance; }
+
+    /**
+     * @brief Returns the frame count, dropped frames, the refresh period and the frame time histogram in microseconds.
+     */
+    QVariantMap statistics() const;
+
+    void reset();
+
+ private:
+    void onFrame();
+
+    static FrameTimeMonitor* s_instance;
+    static const qint64      IDLE_INTERVAL = 1000000;  // microseconds
+
+    QQuickWindow*    m_window;
+    QElapsedTimer    m_timer;
+    qint64           m_lastFrame     = -1;  // microseconds of m_timer
+    qint64           m_refreshPeriod = 16667;
+    LatencyHistogram m_frameTime;
+    quint32          m_droppedFrames = 0;
+};
@@ -0,0 +1,157 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2020 Markus Zehnder <business@markuszehnder.ch>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+
+#include "commandqueue.h"
+
+#include <QLoggingCategory>
+#include <QtDebug>
+
+#include "integrationthreads.h"
+
+static Q_LOGGING_CATEGORY(CLASS_LC, "plugin.commands");
+
+static const char *LANE_NAMES[] = {"user", "background"};
+
+CommandQueue::CommandQueue(const QString &integrationId, QObject *parent)
+    : QObject(parent), m_integrationId(integrationId) {
+    m_clock.start();
+}
+
+void CommandQueue::setIntegration(IntegrationInterface *integration) {
+    m_integration = integration;
+    // a new instance reports its own connection state
+    m_connected = false;
+    m_inFlight  = 0;
+    m_generation++;
+}
+
+void CommandQueue::setConnected(bool connected) {
+    m_connected          = connected;
+    m_connectionReported = true;
+    if (connected) {
+        flush();
+    }
+}
+
+void CommandQueue::send(const QString &entityType, const QString &entityId, int command, const QVariant &param,
+                        Lane lane) {
+    QQueue<Command> &queue = m_lanes[lane];
+    LaneStatistics & stats = m_statistics[lane];
+
+    if (queue.size() >= MAX_DEPTH) {
+        // the oldest command is the most likely to be stale
+        queue.dequeue();
+        stats.dropped++;
+    }
+    queue.enqueue({entityType, entityId, command, param, m_clock.elapsed()});
+    stats.maxDepth = qMax(stats.maxDepth, queue.size());
+
+    if (!m_connected && m_connectionReported) {
+        qCDebug(CLASS_LC) << "Holding command for disconnected integration" << m_integrationId << entityId << command;
+    }
+    flush();
+}
+
+void CommandQueue::clear() {
+    for (QQueue<Command> &queue : m_lanes) {
+        queue.clear();
+    }
+}
+
+QVariantMap CommandQueue::statistics() const {
+    QVariantMap stats;
+    for (int lane = 0; lane < LANES; lane++) {
+        const LaneStatistics &laneStats = m_statistics[lane];
+
+        QVariantMap map;
+        map.insert("depth", m_lanes[lane].size());
+        map.insert("max_depth", laneStats.maxDepth);
+        map.insert("sent", laneStats.sent);
+        map.insert("expired", laneStats.expired);
+        map.insert("dropped", laneStats.dropped);
+        map.insert("latency", laneStats.latency.toVariantMap());
+        stats.insert(LANE_NAMES[lane], map);
+    }
+    QVariantMap suppressed;
+    for (auto iter = m_suppressed.cbegin(); iter != m_suppressed.cend(); ++iter) {
+        suppressed.insert(iter.key(), iter.value());
+    }
+    stats.insert("suppressed", suppressed);
+    stats.insert("connected", m_connected);
+    return stats;
+}
+
+void CommandQueue::resetStatistics() {
+    for (LaneStatistics &stats : m_statistics) {
+        stats = LaneStatistics();
+    }
+    m_suppressed.clear();
+}
+
+void CommandQueue::flush() {
+    if (m_flushing) {
+        return;
+    }
+    m_flushing = true;
+
+    while ((m_connected || !m_connectionReported) && m_integration && m_inFlight == 0) {
+        int lane = USER;
+        while (lane < LANES && m_lanes[lane].isEmpty()) {
+            lane++;
+        }
+        if (lane == LANES) {
+            break;
+        }
+
+        Command command = m_lanes[lane].dequeue();
+        qint64  waited  = m_clock.elapsed() - command.queued;
+        if (waited > (lane == USER ? USER_TTL : BACKGROUND_TTL)) {
+            qCDebug(CLASS_LC) << "Command expired after" << waited << "ms:" << m_integrationId << command.entityId
+                              << command.command;
+            m_statistics[lane].expired++;
+            continue;
+        }
+        m_statistics[lane].sent++;
+        m_statistics[lane].latency.record(waited * 1000);
+
+        // handed over in the thread of the integration, the next command is sent when it returned
+        m_inFlight++;
+        quint32 generation = m_generation;
+        IntegrationThreads::post(m_integration, [this, command, generation](IntegrationInterface *integration) {
+            integration->sendCommand(command.entityType, command.entityId, command.command, command.param);
+            QMetaObject::invokeMethod(this, [this, generation]() { onHandedOver(generation); }, Qt::AutoConnection);
+        });
+        emit commandHandedOver(command.entityType, command.entityId, command.command);
+    }
+
+    m_flushing = false;
+}
+
+void CommandQueue::onHandedOver(quint32 generation) {
+    if (generation != m_generation) {
+        // sent to a removed or replaced instance, the in-flight count belongs to the current one
+        return;
+    }
+    m_inFlight = qMax(0, m_inFlight - 1);
+    flush();
+}
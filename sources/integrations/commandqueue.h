@@ -0,0 +1,130 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2020 Markus Zehnder <business@markuszehnder.ch>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QQueue>
+#include <QVariant>
+
+#include "../latencyhistogram.h"
+#include "yio-interface/integrationinterface.h"
+
+/**
+ * @brief CommandQueue sits between the entities and IntegrationInterface::sendCommand of one integration.
+ * Commands are queued in priority lanes: user interaction is handed over before background traffic like media
+ * browsing. Only one command at a time is handed over to the thread of the integration, so a user command never waits
+ * behind a backlog of background commands.
+ * While the integration is disconnected, commands are held and replayed after reconnect unless they are older than the
+ * TTL of their lane. Integrations which never report a connection state through their entities are treated as
+ * connected: commands are handed over right away.
+ */
+class CommandQueue : public QObject {
+    Q_OBJECT
+
+ public:
+    enum Lane { USER, BACKGROUND, LANES };
+
+    explicit CommandQueue(const QString& integrationId, QObject* parent = nullptr);
+
+    /**
+     * @brief Sets the integration instance, nullptr while it is removed or re-created. Held commands are kept.
+     */
+    void setIntegration(IntegrationInterface* integration);
+
+    /**
+     * @brief Sets the connection state reported by the integration, held commands are replayed on connect. Until the
+     * first report, commands are not held.
+     */
+    void setConnected(bool connected);
+    bool isConnected() const { return m_connected; }
+
+    /**
+     * @brief Queues a command for the integration.
+     */
+    void send(const QString& entityType, const QString& entityId, int command, const QVariant& param, Lane lane);
+
+    /**
+     * @brief Drops all held commands.
+     */
+    void clear();
+
+    /**
+     * @brief Counts a value of a rate limited command which has been replaced by a newer value before it was sent.
+     * @param command entity type and command name, e.g. light.BRIGHTNESS
+     */
+    void recordSuppressed(const QString& command) { m_suppressed[command]++; }
+
+    /**
+     * @brief Returns per lane: depth, max_depth, sent, expired, dropped and the latency from queueing until the command
+     * is handed over to the integration, in microseconds. Suppressed sends of rate limited commands per command.
+     */
+    QVariantMap statistics() const;
+    void        resetStatistics();
+
+ signals:
+    /**
+     * @brief Emitted when a command is handed over to the thread of the integration.
+     */
+    void commandHandedOver(const QString& entityType, const QString& entityId, int command);
+
+ private:
+    struct Command {
+        QString  entityType;
+        QString  entityId;
+        int      command;
+        QVariant param;
+        qint64   queued;  // ms of m_clock
+    };
+
+    struct LaneStatistics {
+        LatencyHistogram latency;
+        int              maxDepth = 0;
+        quint32          sent = 0;
+        quint32          expired = 0;
+        quint32          dropped = 0;
+    };
+
+    void flush();
+    void onHandedOver(quint32 generation);
+
+    static const int MAX_DEPTH = 50;
+    static const int USER_TTL = 10000;
+    static const int BACKGROUND_TTL = 5000;
+
+    QString               m_integrationId;
+    IntegrationInterface* m_integration = nullptr;
+    bool                  m_connected = false;
+    bool                  m_connectionReported = false;  // kept for re-created instances of the integration
+    bool                  m_flushing = false;
+    int                   m_inFlight = 0;
+    quint32               m_generation = 0;  // incremented per instance, hand-overs to a replaced one are ignored
+    QElapsedTimer         m_clock;
+
+    QQueue<Command> m_lanes[LANES];
+    LaneStatistics  m_statistics[LANES];
+
+    QHash<QString, quint32> m_suppressed;  // entity type.command -> values replaced before being sent
+};
@@ -22,15 +22,18 @@
 
 #include "integrations.h"
 
-#include <QDirIterator>
+#include <QCoreApplication>
 #include <QLoggingCategory>
 #include <QPluginLoader>
+#include <QRunnable>
 #include <QtDebug>
 
 #include "../config.h"
+#include "../configutil.h"
 #include "../entities/entities.h"
 #include "../launcher.h"
 #include "../notifications.h"
+#include "../translation.h"
 #include "../yioapi.h"
 
 IntegrationsInterface::~IntegrationsInterface() {}
@@ -39,19 +42,79 @@ Integrations* Integrations::s_instance = nullptr;
 
 static Q_LOGGING_CATEGORY(CLASS_LC, "plugin");
 
-Integrations::Integrations(const QString& pluginPath) : m_pluginPath(pluginPath) {
-    s_instance = this;
+static QObject* instantiatePlugin(const QString& fileName, QString* error) {
+    if (fileName.isEmpty()) {
+        *error = "Plugin not found";
+        return nullptr;
+    }
+    QPluginLoader pluginLoader(fileName);
+    QObject*      plugin = pluginLoader.instance();
+    if (!plugin) {
+        *error = pluginLoader.errorString();
+    }
+    return plugin;
+}
 
-    // scan for plugins
-    QDirIterator it(m_pluginPath);
-    while (it.hasNext()) {
-        QPluginLoader pluginLoader(it.next());
-        QString       pluginName = pluginLoader.metaData()["MetaData"].toObject().value("name").toString();
-        if (pluginName != "") {
-            m_supportedIntegrations.append(pluginName.toLower());
-            qCDebug(CLASS_LC()) << "Adding supported integration type:" << pluginName;
+/**
+ * @brief Loads a thread safe plugin in the thread pool and hands the instance over to the thread of Integrations.
+ */
+class PluginLoadTask : public QRunnable {
+ public:
+    PluginLoadTask(Integrations* integrations, const QString& type, const QString& fileName)
+        : m_integrations(integrations), m_type(type), m_fileName(fileName) {}
+
+    void run() override {
+        QElapsedTimer timer;
+        timer.start();
+
+        QString  error;
+        QObject* plugin = instantiatePlugin(m_fileName, &error);
+        if (plugin) {
+            // the root instance is created in this pool thread
+            plugin->moveToThread(m_integrations->thread());
         }
+        qint64 loadTime = timer.elapsed();
+
+        Integrations* integrations = m_integrations;
+        QString       type = m_type;
+        QMetaObject::invokeMethod(
+            integrations,
+            [integrations, type, plugin, loadTime, error]() {
+                integrations->onPluginLoaded(type, plugin, loadTime, true, error);
+            },
+            Qt::QueuedConnection);
     }
+
+ private:
+    Integrations* m_integrations;
+    QString       m_type;
+    QString       m_fileName;
+};
+
+Integrations::Integrations(const QString& pluginPath, const QString& indexFilePath)
+    : m_pluginPath(pluginPath), m_index(pluginPath, indexFilePath) {
+    s_instance = this;
+
+    m_loadPool.setObjectName("PluginLoader");
+    m_loadTimeout.setSingleShot(true);
+    m_loadTimeout.setInterval(LOAD_COMPLETE_TIMEOUT);
+    connect(&m_loadTimeout, &QTimer::timeout, this, [this]() {
+        if (!m_loadCompleted) {
+            qCWarning(CLASS_LC) << "Integrations still loading after" << LOAD_COMPLETE_TIMEOUT
+                                << "ms:" << m_pendingCreate.keys();
+            m_loadCompleted = true;
+            emit loadComplete();
+        }
+    });
+
+    // only new or changed plugins are opened, everything else comes from the stored index
+    m_index.refresh();
+    m_supportedIntegrations = m_index.types();
+    qCDebug(CLASS_LC()) << "Supported integration types:" << m_supportedIntegrations;
+
+    m_threads.setPoolSize(
+        ConfigUtil::getValue(Config::getInstance()->getSettings(), "integrations/threads", DEFAULT_THREADS).toInt());
+    connect(qApp, &QCoreApplication::aboutToQuit, &m_threads, &IntegrationThreads::stop);
 }
 
 QObject* Integrations::loadPlugin(const QString& type) {
@@ -85,21 +148,25 @@ void Integrations::createInstance(QObject* pluginObj, QVariantMap map) {
     YioAPI*        api = YioAPI::getInstance();
     Config*        config = Config::getInstance();
 
+    // the integrations are placed on threads by Integrations, not by the plugin
+    QVariantList data = map.value(Config::OBJ_DATA).toList();
+    for (QVariant& item : data) {
+        QVariantMap instance = item.toMap();
+        m_threadPolicies.insert(instance.value(Config::KEY_ID).toString(), IntegrationThreads::policy(instance));
+        instance.insert(Config::KEY_WORKERTHREAD, false);
+        item = instance;
+    }
+    map.insert(Config::OBJ_DATA, data);
+
     PluginInterface* interface = qobject_cast<PluginInterface*>(pluginObj);
     if (interface) {
-        connect(interface, &PluginInterface::createDone, this, &Integrations::onCreateDone);
+        connect(interface, &PluginInterface::createDone, this, &Integrations::onCreateDone, Qt::UniqueConnection);
 
         interface->create(map, entities, notifications, api, config);
     }
 }
 
-QJsonObject Integrations::getPluginMetaData(const QString& pluginName) {
-    Launcher* launcher = new Launcher();
-    QString   pluginPath = launcher->getPluginPath(m_pluginPath, pluginName);
-    qCDebug(CLASS_LC()) << "Getting metadata for:" << pluginPath;
-    QPluginLoader pluginLoader(pluginPath);
-    return pluginLoader.metaData()["MetaData"].toObject();
-}
+QJsonObject Integrations::getPluginMetaData(const QString& pluginName) { return m_index.metaData(pluginName); }
 
 // Integrations::~Integrations() { s_instance = nullptr; }
 
@@ -113,46 +180,218 @@ void Integrations::load() {
 
     // let's load the plugins
     m_integrationsToLoad = c.count();
+    m_integrationsLoaded = 0;
+    m_loadCompleted = false;
+    m_loadReport.clear();
+    m_loadTimer.start();
 
     for (QVariantMap::const_iterator iter = c.cbegin(); iter != c.cend(); ++iter) {
-        QObject* obj;
-        if (!isPluginLoaded(iter.key())) {
-            // load the plugin
-            obj = loadPlugin(iter.key());
-        } else {
-            obj = getPlugin(iter.key());
+        // push the config to the integration
+        QVariantMap map = iter.value().toMap();
+        map.insert(Config::KEY_TYPE, iter.key());
+
+        if (isPluginLoaded(iter.key())) {
+            QObject* obj = getPlugin(iter.key());
+            // if the plugin is the config, but not in the plugins directory
+            if (obj == nullptr) {
+                m_integrationsToLoad--;
+                continue;
+            }
+            m_loadReport[iter.key()].loadTime = 0;
+            m_loadReport[iter.key()].createStart = m_loadTimer.elapsed();
+            createInstance(obj, map);
+            continue;
         }
 
-        // if the plugin is the config, but not in the plugins directory
-        if (obj == nullptr) {
-            m_integrationsToLoad--;
+        bool loading = m_pendingCreate.contains(iter.key());
+        m_pendingCreate.insert(iter.key(), map);
+        if (loading) {
+            continue;
+        } else if (m_index.metaData(iter.key()).value("thread_safe").toBool()) {
+            m_loadPool.start(new PluginLoadTask(this, iter.key(), m_index.fileName(iter.key())));
+        } else if (!m_mainThreadQueue.contains(iter.key())) {
+            m_mainThreadQueue.append(iter.key());
         }
+    }
 
-        // push the config to the integration
-        QVariantMap map = iter.value().toMap();
-        map.insert(Config::KEY_TYPE, iter.key());
+    if (!m_mainThreadQueue.isEmpty()) {
+        // one plugin per event loop iteration to keep the UI responsive
+        QMetaObject::invokeMethod(this, &Integrations::loadNextPlugin, Qt::QueuedConnection);
+    }
+
+    m_loadTimeout.start();
+    checkLoadComplete();
+}
 
-        // create instance of the integration
-        createInstance(obj, map);
+void Integrations::loadNextPlugin() {
+    if (m_mainThreadQueue.isEmpty()) {
+        return;
     }
+    QString type = m_mainThreadQueue.takeFirst();
 
-    if (m_integrationsToLoad == 0) {
+    QElapsedTimer timer;
+    timer.start();
+    QString  error;
+    QObject* plugin = instantiatePlugin(m_index.fileName(type), &error);
+    onPluginLoaded(type, plugin, timer.elapsed(), false, error);
+
+    if (!m_mainThreadQueue.isEmpty()) {
+        QMetaObject::invokeMethod(this, &Integrations::loadNextPlugin, Qt::QueuedConnection);
+    }
+}
+
+void Integrations::onPluginLoaded(const QString& type, QObject* plugin, qint64 loadTime, bool threaded,
+                                  const QString& error) {
+    LoadReport& report = m_loadReport[type];
+    report.loadTime = loadTime;
+    report.threaded = threaded;
+    report.error = error;
+
+    // store the plugin objects
+    m_plugins.insert(type, plugin);
+
+    QVariantMap map = m_pendingCreate.take(type);
+    if (!plugin) {
+        qCCritical(CLASS_LC) << "FAILED TO LOAD PLUGIN:" << type << error;
+        Notifications::getInstance()->add(true, "Failed to load " + type);
+        m_integrationsToLoad--;
+        checkLoadComplete();
+        return;
+    }
+
+    qCInfo(CLASS_LC) << "LOADED PLUGIN:" << type << "version:" << m_index.metaData(type).value("version").toString()
+                     << "in" << loadTime << "ms" << (threaded ? "(thread pool)" : "");
+
+    if (m_loadCompleted && TranslationHandler::getInstance()) {
+        // the language has already been selected for the plugins loaded in time
+        TranslationHandler::getInstance()->installPluginTranslator(plugin);
+    }
+
+    report.createStart = m_loadTimer.elapsed();
+    createInstance(plugin, map);
+}
+
+void Integrations::checkLoadComplete() {
+    if (m_integrationsLoaded != m_integrationsToLoad) {
+        return;
+    }
+    m_loadTimeout.stop();
+    logLoadReport();
+
+    if (!m_loadCompleted) {
+        m_loadCompleted = true;
         emit loadComplete();
     }
 }
 
+void Integrations::logLoadReport() {
+    qCInfo(CLASS_LC) << "Plugin startup report:" << m_integrationsLoaded << "integrations ready in"
+                     << m_loadTimer.elapsed() << "ms";
+    for (QMap<QString, LoadReport>::const_iterator iter = m_loadReport.cbegin(); iter != m_loadReport.cend(); ++iter) {
+        const LoadReport& report = iter.value();
+        if (!report.error.isEmpty()) {
+            qCInfo(CLASS_LC).noquote() << QString("  %1 failed: %2").arg(iter.key(), -20).arg(report.error);
+            continue;
+        }
+        qCInfo(CLASS_LC).noquote() << QString("  %1 load %2 ms%3, create %4 ms, ready at %5 ms")
+                                          .arg(iter.key(), -20)
+                                          .arg(report.loadTime)
+                                          .arg(report.threaded ? " (thread pool)" : "")
+                                          .arg(report.createTime)
+                                          .arg(report.readyAt);
+    }
+}
+
 void Integrations::onCreateDone(QMap<QObject*, QVariant> map) {
+    QString type = m_plugins.key(sender());
+
+    // The initial create() of the type may still be outstanding: the instances tell which call they belong to.
+    bool instanceCreate = false;
+    for (const QVariant& config : map) {
+        if (m_instanceCreates.remove(config.toMap().value(Config::KEY_ID).toString())) {
+            instanceCreate = true;
+        }
+    }
+    if (instanceCreate) {
+        // created by createIntegration: only the entities of these instances are bound
+        addCreated(map, true);
+        return;
+    }
+
+    LoadReport& report = m_loadReport[type];
+    report.readyAt = m_loadTimer.elapsed();
+    report.createTime = report.readyAt - report.createStart;
+
+    // entities are already loaded without integrations which are ready after loadComplete
+    addCreated(map, m_loadCompleted);
+    m_integrationsLoaded++;
+
+    qCDebug(CLASS_LC) << "Integrations loaded:" << m_integrationsLoaded << "from:" << m_integrationsToLoad << type
+                      << "in" << report.createTime << "ms";
+
+    checkLoadComplete();
+}
+
+void Integrations::addCreated(const QMap<QObject*, QVariant>& map, bool bindEntities) {
     // add the integrations to the integration database
     for (QMap<QObject*, QVariant>::const_iterator iter = map.cbegin(); iter != map.cend(); ++iter) {
-        add(iter.value().toMap(), iter.key(), iter.value().toMap().value("type").toString());
+        QVariantMap config = iter.value().toMap();
+        QString     id = config.value(Config::KEY_ID).toString();
+        add(config, iter.key(), config.value("type").toString());
+        m_threads.place(id, iter.key(), m_threadPolicies.take(id));
+
+        if (bindEntities) {
+            Entities::getInstance()->bindIntegration(id, qobject_cast<IntegrationInterface*>(iter.key()));
+        }
     }
-    m_integrationsLoaded++;
+}
 
-    qCDebug(CLASS_LC) << "Integrations loaded:" << m_integrationsLoaded << "from:" << m_integrationsToLoad;
+bool Integrations::createIntegration(const QString& type, const QVariantMap& config) {
+    if (!m_index.contains(type)) {
+        return false;
+    }
 
-    if (m_integrationsLoaded == m_integrationsToLoad) {
-        emit loadComplete();
+    if (m_pendingCreate.contains(type)) {
+        // the plugin is still loading, the instance is created together with the configured ones
+        QVariantMap& pending = m_pendingCreate[type];
+        QVariantList data = pending.value(Config::OBJ_DATA).toList();
+        data.append(config);
+        pending.insert(Config::OBJ_DATA, data);
+        return true;
+    }
+
+    QObject* plugin = isPluginLoaded(type) ? getPlugin(type) : loadPlugin(type);
+    if (!plugin) {
+        return false;
+    }
+
+    // the plugin creates an instance for every entry in data
+    QVariantMap map = Config::getInstance()->getIntegration(type);
+    map.insert(Config::OBJ_DATA, QVariantList{config});
+    map.insert(Config::KEY_TYPE, type);
+
+    qCDebug(CLASS_LC) << "Creating integration:" << type << config.value(Config::KEY_ID).toString();
+    m_instanceCreates.insert(config.value(Config::KEY_ID).toString());
+    createInstance(plugin, map);
+    return true;
+}
+
+bool Integrations::updateIntegration(const QString& type, const QVariantMap& config) {
+    QString id = config.value(Config::KEY_ID).toString();
+    if (!m_integrations.contains(id) || !canCreateIntegration(type)) {
+        return false;
+    }
+
+    // the entities stay loaded and are bound to the new instance when it is created
+    remove(id);
+    return createIntegration(type, config);
+}
+
+bool Integrations::canCreateIntegration(const QString& type) {
+    if (!m_index.contains(type)) {
+        return false;
     }
+    return m_pendingCreate.contains(type) || isPluginLoaded(type) || loadPlugin(type) != nullptr;
 }
 
 QList<QObject*> Integrations::list() { return m_integrations.values(); }
@@ -176,15 +415,65 @@ void Integrations::add(const QVariantMap& config, QObject* obj, const QString& t
     m_integrations.insert(id, obj);
     m_integrationsFriendlyNames.insert(id, config.value(Config::KEY_FRIENDLYNAME).toString());
     m_integrationsTypes.insert(id, type);
+
+    CommandQueue* queue = m_commandQueues.value(id);
+    if (!queue) {
+        queue = new CommandQueue(id, this);
+        m_commandQueues.insert(id, queue);
+        connect(queue, &CommandQueue::commandHandedOver, this, &Integrations::commandHandedOver);
+    }
+    queue->setIntegration(qobject_cast<IntegrationInterface*>(obj));
+    if (Entities::getInstance()) {
+        connect(Entities::getInstance(), &Entities::integrationConnectionChanged, this,
+                &Integrations::onIntegrationConnectionChanged, Qt::UniqueConnection);
+    }
     emit listChanged();
 }
 
 void Integrations::remove(const QString& id) {
-    m_integrations.remove(id);
+    QObject* obj = m_integrations.take(id);
     m_integrationsFriendlyNames.remove(id);
+    m_integrationsMdns.remove(id);
+    m_integrationsTypes.remove(id);
+
+    if (obj) {
+        // entities which are kept must not call the deleted instance, their commands are held
+        Entities::getInstance()->bindIntegration(id, nullptr);
+        if (m_commandQueues.contains(id)) {
+            m_commandQueues.value(id)->setIntegration(nullptr);
+        }
+
+        // the object is deleted in its thread after the disconnect
+        IntegrationInterface* integration = qobject_cast<IntegrationInterface*>(obj);
+        if (integration) {
+            IntegrationThreads::post(integration, [](IntegrationInterface* ii) { ii->disconnect(); });
+        }
+        obj->deleteLater();
+    }
     emit listChanged();
 }
 
+void Integrations::onIntegrationConnectionChanged(const QString& integrationId, bool connected) {
+    CommandQueue* queue = m_commandQueues.value(integrationId);
+    if (queue) {
+        queue->setConnected(connected);
+    }
+}
+
+QVariantMap Integrations::commandStatistics() const {
+    QVariantMap stats;
+    for (auto iter = m_commandQueues.cbegin(); iter != m_commandQueues.cend(); ++iter) {
+        stats.insert(iter.key(), iter.value()->statistics());
+    }
+    return stats;
+}
+
+void Integrations::resetCommandStatistics() {
+    for (CommandQueue* queue : qAsConst(m_commandQueues)) {
+        queue->resetStatistics();
+    }
+}
+
 QString Integrations::getFriendlyName(const QString& id) { return m_integrationsFriendlyNames.value(id); }
 
 QString Integrations::getFriendlyName(QObject* obj) {
@@ -194,23 +483,8 @@ QString Integrations::getFriendlyName(QObject* obj) {
 
 QString Integrations::getMDNS(const QString& id) { return m_integrationsMdns.value(id); }
 
-QStringList Integrations::getMDNSList() {
-    QStringList mdnsList;
-    for (int i = 0; i < m_supportedIntegrations.length(); i++) {
-        mdnsList.append(getPluginMetaData(m_supportedIntegrations[i]).toVariantMap().value("mdns").toString());
-    }
-
-    return mdnsList;
-}
+QStringList Integrations::getMDNSList() { return m_index.mdnsList(); }
 
 QString Integrations::getType(const QString& id) { return m_integrationsTypes.value(id); }
 
-QString Integrations::getTypeByMdns(const QString& mdns) {
-    for (int i = 0; i < m_supportedIntegrations.length(); i++) {
-        if (getPluginMetaData(m_supportedIntegrations[i]).toVariantMap().value("mdns").toString() == mdns) {
-            return m_supportedIntegrations[i];
-        }
-    }
-
-    return "";
-}
+QString Integrations::getTypeByMdns(const QString& mdns) { return m_index.typeByMdns(mdns); }
@@ -22,10 +22,19 @@
 
 #pragma once
 
+#include <QElapsedTimer>
+#include <QHash>
 #include <QMap>
 #include <QObject>
+#include <QSet>
+#include <QThreadPool>
+#include <QTimer>
 
+#include "commandqueue.h"
 #include "integrationsinterface.h"
+#include "integrationthreads.h"
+#include "pluginindex.h"
+#include "reconnectscheduler.h"
 #include "yio-interface/integrationinterface.h"
 #include "yio-interface/plugininterface.h"
 
@@ -37,7 +46,8 @@ class Integrations : public QObject, IntegrationsInterface {
     // list of all integrations
     Q_PROPERTY(QList<QObject*> list READ list NOTIFY listChanged)
 
-    // load all integrations from config file
+    // load all integrations from config file. Plugins marked with "thread_safe": true in their metadata are loaded in
+    // parallel in a thread pool, all others one by one in the GUI thread.
     Q_INVOKABLE void load();
 
     // get all integrations
@@ -52,9 +62,20 @@ class Integrations : public QObject, IntegrationsInterface {
     // add an integration
     void add(const QVariantMap& config, QObject* obj, const QString& type) override;
 
-    // remove an integraiton
+    // remove an integraiton: the instance is disconnected and deleted, its remaining entities are unbound
     void remove(const QString& id);
 
+    // create a single integration instance from its config, other instances of the type are not touched.
+    // Entities of the integration are bound when the plugin reports the instance as created.
+    bool createIntegration(const QString& type, const QVariantMap& config);
+
+    // re-create a single integration instance with a new config and rebind its entities. The old instance is kept if
+    // the plugin can't be loaded.
+    bool updateIntegration(const QString& type, const QVariantMap& config);
+
+    // true if instances of the type can be created: the plugin is loaded, being loaded or loads successfully
+    bool canCreateIntegration(const QString& type);
+
     // get friendly name
     Q_INVOKABLE QString getFriendlyName(const QString& id);
     Q_INVOKABLE QString getFriendlyName(QObject* obj);
@@ -70,7 +91,7 @@ class Integrations : public QObject, IntegrationsInterface {
     // get a list of supported integrations
     QStringList supportedIntegrations() { return m_supportedIntegrations; }
 
-    explicit Integrations(const QString& pluginPath);
+    Integrations(const QString& pluginPath, const QString& indexFilePath);
 
     // get all plugins
     QObject*        loadPlugin(const QString& type);
@@ -84,16 +105,58 @@ class Integrations : public QObject, IntegrationsInterface {
     // get plugin metadata
     QJsonObject getPluginMetaData(const QString& pluginName);
 
+    // command queue of an integration, nullptr if it has never been created
+    CommandQueue* commandQueue(const QString& integrationId) { return m_commandQueues.value(integrationId); }
+    QVariantMap   commandStatistics() const;
+    void          resetCommandStatistics();
+
+    // connects the integrations after startup and wakeup
+    ReconnectScheduler* reconnectScheduler() { return &m_reconnect; }
+
+    // name, policy, integrations and CPU time of the integration threads
+    QVariantList threadStatistics() { return m_threads.statistics(); }
+
     static Integrations* getInstance() { return s_instance; }
 
  signals:
     void listChanged();
     void loadComplete();
 
+    // a command has been handed over to the thread of an integration by its command queue
+    void commandHandedOver(const QString& entityType, const QString& entityId, int command);
+
  public slots:  // NOLINT open issue: https://github.com/cpplint/cpplint/pull/99
     void onCreateDone(QMap<QObject*, QVariant> map);
 
+    // the entities of an integration have been set connected or disconnected
+    void onIntegrationConnectionChanged(const QString& integrationId, bool connected);
+
+    // a plugin has been loaded by load(), plugin is nullptr on error
+    void onPluginLoaded(const QString& type, QObject* plugin, qint64 loadTime, bool threaded, const QString& error);
+
  private:
+    // startup report entry of a plugin, times in ms
+    struct LoadReport {
+        qint64  loadTime = -1;    // dlopen and plugin instance
+        qint64  createTime = -1;  // create() until createDone
+        qint64  createStart = -1;
+        qint64  readyAt = -1;  // since load()
+        bool    threaded = false;
+        QString error;
+    };
+
+    void loadNextPlugin();
+    void addCreated(const QMap<QObject*, QVariant>& map, bool bindEntities);
+    void checkLoadComplete();
+    void logLoadReport();
+
+    // loadComplete is emitted after this time even if slow integrations are still loading, they are bound to their
+    // entities as soon as they are ready
+    static const int LOAD_COMPLETE_TIMEOUT = 3000;
+
+    // default maximum number of shared integration threads, setting integrations/threads
+    static const int DEFAULT_THREADS = 2;
+
     QStringList m_supportedIntegrations;
 
     QMap<QString, QObject*> m_plugins;
@@ -102,8 +165,25 @@ class Integrations : public QObject, IntegrationsInterface {
     QMap<QString, QString>  m_integrationsMdns;
     QMap<QString, QString>  m_integrationsTypes;
     QString                 m_pluginPath;
+    PluginIndex             m_index;
     int                     m_integrationsToLoad = 0;
     int                     m_integrationsLoaded = 0;
 
+    QThreadPool                m_loadPool;
+    QElapsedTimer              m_loadTimer;
+    QTimer                     m_loadTimeout;
+    bool                       m_loadCompleted = false;
+    QStringList                m_mainThreadQueue;  // plugins which must be loaded in the GUI thread
+    QMap<QString, QVariantMap> m_pendingCreate;    // integration type -> config waiting for the plugin
+    QMap<QString, LoadReport>  m_loadReport;
+    QSet<QString>              m_instanceCreates;  // integration ids of outstanding createIntegration calls
+
+    IntegrationThreads                         m_threads;
+    ReconnectScheduler                         m_reconnect;
+
+    // integration id -> queue, kept when an integration is removed: commands may still be handed over
+    QHash<QString, CommandQueue*> m_commandQueues;
+    QHash<QString, IntegrationThreads::Policy> m_threadPolicies;  // integration id -> policy until created
+
     static Integrations* s_instance;
 };
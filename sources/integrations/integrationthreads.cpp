@@ -0,0 +1,220 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2020 Markus Zehnder <business@markuszehnder.ch>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+
+#include "integrationthreads.h"
+
+#include <QFile>
+#include <QLoggingCategory>
+#include <QtDebug>
+
+#ifdef Q_OS_LINUX
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "../config.h"
+
+static Q_LOGGING_CATEGORY(CLASS_LC, "plugin.threads");
+
+IntegrationThreads::IntegrationThreads(QObject *parent) : QObject(parent) {
+    ThreadInfo &gui = m_threads[thread()];
+    gui.policy      = GUI;
+    gui.tid         = threadId();
+    m_order.append(thread());
+    m_sampleTimer.start();
+}
+
+IntegrationThreads::~IntegrationThreads() { stop(); }
+
+IntegrationThreads::Policy IntegrationThreads::policy(const QVariantMap &config) {
+    QString policy = config.value("thread").toString();
+    if (policy == "gui") {
+        return GUI;
+    } else if (policy == "shared") {
+        return SHARED;
+    } else if (policy == "dedicated") {
+        return DEDICATED;
+    }
+    return config.value(Config::KEY_WORKERTHREAD).toBool() ? SHARED : GUI;
+}
+
+IntegrationThreads::Policy IntegrationThreads::place(const QString &integrationId, QObject *obj, Policy policy) {
+    if (policy == SHARED && m_poolSize < 1) {
+        policy = GUI;
+    }
+    if (obj->thread() != thread()) {
+        qCWarning(CLASS_LC) << "Integration" << integrationId << "runs in a thread of the plugin";
+        return policy;
+    }
+    if (policy != GUI && obj->parent()) {
+        qCWarning(CLASS_LC) << "Integration" << integrationId << "has a parent and can't be moved to a worker thread";
+        policy = GUI;
+    }
+
+    QThread *target = thread();
+    if (policy == DEDICATED) {
+        target = startThread(QString("Integration %1").arg(integrationId), DEDICATED);
+    } else if (policy == SHARED) {
+        target = sharedThread();
+    }
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_threads[target].integrations.append(integrationId);
+    }
+    if (target != thread()) {
+        obj->moveToThread(target);
+    }
+    qCDebug(CLASS_LC) << "Integration" << integrationId << "runs in thread" << target->objectName();
+
+    // destroyed is emitted in the thread of the object
+    connect(obj, &QObject::destroyed, this, [this, target, integrationId]() { release(target, integrationId); });
+    return policy;
+}
+
+void IntegrationThreads::stop() {
+    QList<QThread *> threads;
+    {
+        QMutexLocker locker(&m_mutex);
+        for (QThread *thread : qAsConst(m_order)) {
+            if (thread != this->thread()) {
+                threads.append(thread);
+            }
+        }
+    }
+    for (QThread *thread : threads) {
+        thread->quit();
+        thread->wait();
+    }
+}
+
+QVariantList IntegrationThreads::statistics() {
+    QMutexLocker locker(&m_mutex);
+
+    qint64 elapsed = m_sampleTimer.restart();
+
+    QVariantList list;
+    for (QThread *thread : qAsConst(m_order)) {
+        ThreadInfo &info = m_threads[thread];
+        qint64      cpu  = cpuTime(info.tid);
+
+        QVariantMap stats;
+        stats.insert("name", thread == this->thread() ? QString("GUI") : thread->objectName());
+        stats.insert("policy", info.policy == GUI ? "gui" : info.policy == SHARED ? "shared" : "dedicated");
+        stats.insert("tid", info.tid);
+        stats.insert("integrations", info.integrations);
+        stats.insert("cpu_ms", cpu);
+        if (cpu >= 0 && elapsed > 0) {
+            stats.insert("cpu_load", 100.0 * (cpu - info.cpuTime) / elapsed);
+        }
+        info.cpuTime = cpu;
+        list.append(stats);
+    }
+    return list;
+}
+
+QThread *IntegrationThreads::startThread(const QString &name, Policy policy) {
+    QThread *thread = new QThread(this);
+    thread->setObjectName(name);
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_threads[thread].policy = policy;
+        m_order.append(thread);
+    }
+
+    // direct connection: runs in the new thread
+    connect(thread, &QThread::started, [this, thread]() {
+        QMutexLocker locker(&m_mutex);
+        m_threads[thread].tid = threadId();
+    });
+    thread->start();
+    return thread;
+}
+
+QThread *IntegrationThreads::sharedThread() {
+    QThread *target = nullptr;
+    int      load   = 0;
+    {
+        QMutexLocker locker(&m_mutex);
+        for (QThread *thread : qAsConst(m_order)) {
+            const ThreadInfo &info = m_threads[thread];
+            if (info.policy == SHARED && (!target || info.integrations.size() < load)) {
+                target = thread;
+                load   = info.integrations.size();
+            }
+        }
+    }
+
+    // a new thread is only started if all threads are busy
+    if (!target || (load > 0 && m_sharedCount < m_poolSize)) {
+        target = startThread(QString("Integrations %1").arg(++m_sharedCount), SHARED);
+    }
+    return target;
+}
+
+void IntegrationThreads::release(QThread *thread, const QString &integrationId) {
+    QMutexLocker locker(&m_mutex);
+
+    auto iter = m_threads.find(thread);
+    if (iter == m_threads.end()) {
+        return;
+    }
+    iter->integrations.removeOne(integrationId);
+
+    if (iter->policy == DEDICATED && iter->integrations.isEmpty()) {
+        m_threads.erase(iter);
+        m_order.removeOne(thread);
+        connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+        thread->quit();
+    }
+}
+
+qint64 IntegrationThreads::threadId() {
+#ifdef Q_OS_LINUX
+    return syscall(SYS_gettid);
+#else
+    return 0;
+#endif
+}
+
+qint64 IntegrationThreads::cpuTime(qint64 tid) {
+#ifdef Q_OS_LINUX
+    QFile file(QString("/proc/self/task/%1/stat").arg(tid));
+    if (tid <= 0 || !file.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    // the command name may contain spaces: the fields are counted after the closing bracket
+    QByteArray        stat   = file.readAll();
+    QList<QByteArray> fields = stat.mid(stat.lastIndexOf(')') + 2).split(' ');
+    if (fields.size() < 13) {
+        return -1;
+    }
+    // utime and stime in clock ticks
+    qint64 ticks = fields[11].toLongLong() + fields[12].toLongLong();
+    return ticks * 1000 / sysconf(_SC_CLK_TCK);
+#else
+    Q_UNUSED(tid)
+    return -1;
+#endif
+}
@@ -0,0 +1,119 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2020 Markus Zehnder <business@markuszehnder.ch>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QStringList>
+#include <QThread>
+#include <QVariantList>
+
+#include "yio-interface/integrationinterface.h"
+
+/**
+ * @brief IntegrationThreads places integration instances on threads by policy:
+ * GUI: the instance stays in the GUI thread.
+ * SHARED: the instance runs on the least loaded thread of a small pool of event loop threads.
+ * DEDICATED: the instance gets an event loop thread of its own.
+ * The CPU time of every thread is read from /proc/self/task to see which integration is burning cycles.
+ */
+class IntegrationThreads : public QObject {
+    Q_OBJECT
+
+ public:
+    enum Policy { GUI, SHARED, DEDICATED };
+
+    explicit IntegrationThreads(QObject* parent = nullptr);
+    ~IntegrationThreads() override;
+
+    /**
+     * @brief Sets the maximum number of shared threads. Threads are started when needed, 0 keeps shared integrations
+     * in the GUI thread.
+     */
+    void setPoolSize(int size) { m_poolSize = size; }
+    int  poolSize() const { return m_poolSize; }
+
+    /**
+     * @brief Returns the policy of an integration instance from the "thread" key of its config: "gui", "shared" or
+     * "dedicated". Without it, instances asking for a worker thread with Config::KEY_WORKERTHREAD run on a shared
+     * thread.
+     */
+    static Policy policy(const QVariantMap& config);
+
+    /**
+     * @brief Moves the integration object to a thread according to the policy. The thread is released when the object
+     * is destroyed. Objects with a parent or living in another thread can't be moved and stay where they are.
+     * @return the policy applied
+     */
+    Policy place(const QString& integrationId, QObject* obj, Policy policy);
+
+    /**
+     * @brief Stops all threads, integrations still living in them don't receive any events afterwards.
+     */
+    void stop();
+
+    /**
+     * @brief Returns name, policy, integrations and CPU time of the GUI thread and all integration threads.
+     * The CPU load is calculated since the previous call.
+     */
+    QVariantList statistics();
+
+    // runs the function with the integration in the thread of the integration object: directly if called from that
+    // thread, queued otherwise
+    template <typename Function>
+    static void post(IntegrationInterface* integration, Function function) {
+        QObject* obj = dynamic_cast<QObject*>(integration);
+        if (!obj || obj->thread() == QThread::currentThread()) {
+            function(integration);
+        } else {
+            QMetaObject::invokeMethod(obj, [integration, function]() { function(integration); }, Qt::QueuedConnection);
+        }
+    }
+
+ private:
+    struct ThreadInfo {
+        Policy      policy = GUI;
+        QStringList integrations;
+        qint64      tid = 0;  // kernel thread id, set when the thread is running
+        qint64      cpuTime = 0;
+    };
+
+    QThread* startThread(const QString& name, Policy policy);
+    QThread* sharedThread();
+    void     release(QThread* thread, const QString& integrationId);
+
+    static qint64 threadId();
+    static qint64 cpuTime(qint64 tid);
+
+    int           m_poolSize = 2;
+    int           m_sharedCount = 0;
+    QElapsedTimer m_sampleTimer;
+
+    // tid is written from the started thread
+    QMutex                      m_mutex;
+    QHash<QThread*, ThreadInfo> m_threads;  // including the GUI thread
+    QList<QThread*>             m_order;    // start order for the statistics
+};
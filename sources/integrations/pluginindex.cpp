@@ -0,0 +1,205 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2020 Markus Zehnder <business@markuszehnder.ch>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+
+#include "pluginindex.h"
+
+#include <QCborArray>
+#include <QCborMap>
+#include <QCborValue>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QLoggingCategory>
+#include <QPluginLoader>
+#include <QSaveFile>
+#include <QtDebug>
+
+static Q_LOGGING_CATEGORY(CLASS_LC, "plugin.index");
+
+// increment if the index format changes
+static const int INDEX_VERSION = 1;
+
+PluginIndex::PluginIndex(const QString &pluginPath, const QString &indexFilePath)
+    : m_pluginPath(pluginPath), m_indexPath(indexFilePath) {}
+
+bool PluginIndex::refresh() {
+    if (m_entries.isEmpty()) {
+        load();
+    }
+
+    bool                  changed = false;
+    QHash<QString, Entry> entries;
+
+    const QFileInfoList files = QDir(m_pluginPath).entryInfoList(QDir::Files | QDir::Readable, QDir::Name);
+    for (const QFileInfo &info : files) {
+        QString path     = info.absoluteFilePath();
+        qint64  modified = info.lastModified().toMSecsSinceEpoch();
+
+        auto iter = m_entries.constFind(path);
+        if (iter != m_entries.constEnd() && iter->size == info.size() && iter->modified == modified) {
+            entries.insert(path, iter.value());
+            continue;
+        }
+
+        // new or changed file: only these are opened
+        entries.insert(path, readPlugin(path, info.size(), modified));
+        changed = true;
+    }
+    changed |= entries.size() != m_entries.size();
+
+    m_entries = entries;
+    updateLookups();
+
+    if (changed) {
+        save();
+    }
+    return changed;
+}
+
+QJsonObject PluginIndex::metaData(const QString &type) const {
+    return m_entries.value(m_byType.value(type)).metaData;
+}
+
+QString PluginIndex::fileName(const QString &type) const { return m_byType.value(type); }
+
+QString PluginIndex::mdns(const QString &type) const { return m_entries.value(m_byType.value(type)).mdns; }
+
+QStringList PluginIndex::mdnsList() const {
+    QStringList list;
+    for (const QString &type : m_types) {
+        list.append(mdns(type));
+    }
+    return list;
+}
+
+PluginIndex::Entry PluginIndex::readPlugin(const QString &path, qint64 size, qint64 modified) {
+    Entry entry;
+    entry.size     = size;
+    entry.modified = modified;
+
+    QPluginLoader pluginLoader(path);
+    entry.metaData = pluginLoader.metaData()["MetaData"].toObject();
+    entry.type     = entry.metaData.value("name").toString().toLower();
+    entry.version  = entry.metaData.value("version").toString();
+    entry.mdns     = entry.metaData.value("mdns").toString();
+
+    QJsonValue translations = entry.metaData.value("translations");
+    if (translations.isArray()) {
+        for (const QJsonValue &translation : translations.toArray()) {
+            entry.translations.append(translation.toString());
+        }
+    } else if (translations.isString()) {
+        entry.translations.append(translations.toString());
+    }
+
+    if (!entry.type.isEmpty()) {
+        qCDebug(CLASS_LC) << "Indexed plugin:" << entry.type << entry.version << path;
+    }
+    return entry;
+}
+
+void PluginIndex::updateLookups() {
+    m_byType.clear();
+    m_typeByMdns.clear();
+    m_types.clear();
+
+    for (auto iter = m_entries.cbegin(); iter != m_entries.cend(); ++iter) {
+        const Entry &entry = iter.value();
+        if (entry.type.isEmpty() || m_byType.contains(entry.type)) {
+            continue;
+        }
+        m_byType.insert(entry.type, iter.key());
+        m_types.append(entry.type);
+        if (!entry.mdns.isEmpty()) {
+            m_typeByMdns.insert(entry.mdns, entry.type);
+        }
+    }
+    m_types.sort();
+}
+
+bool PluginIndex::load() {
+    QFile file(m_indexPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QCborParserError error;
+    QCborValue       index = QCborValue::fromCbor(file.readAll(), &error);
+    if (error.error != QCborError::NoError || !index.isMap() || index["version"].toInteger() != INDEX_VERSION ||
+        index["path"].toString() != m_pluginPath) {
+        qCDebug(CLASS_LC) << "Ignoring outdated plugin index:" << m_indexPath;
+        return false;
+    }
+
+    const QCborMap plugins = index["plugins"].toMap();
+    for (auto iter = plugins.constBegin(); iter != plugins.constEnd(); ++iter) {
+        QCborValue item = iter.value();
+        Entry      entry;
+        entry.size     = item["size"].toInteger();
+        entry.modified = item["modified"].toInteger();
+        entry.type     = item["type"].toString();
+        entry.version  = item["version"].toString();
+        entry.mdns     = item["mdns"].toString();
+        for (const QCborValue &translation : item["translations"].toArray()) {
+            entry.translations.append(translation.toString());
+        }
+        entry.metaData = item["metadata"].toMap().toJsonObject();
+        m_entries.insert(iter.key().toString(), entry);
+    }
+
+    qCDebug(CLASS_LC) << "Plugin index loaded:" << m_entries.size() << "files";
+    return true;
+}
+
+bool PluginIndex::save() const {
+    QCborMap plugins;
+    for (auto iter = m_entries.cbegin(); iter != m_entries.cend(); ++iter) {
+        const Entry &entry = iter.value();
+        QCborMap     item;
+        item.insert(QStringLiteral("size"), entry.size);
+        item.insert(QStringLiteral("modified"), entry.modified);
+        item.insert(QStringLiteral("type"), entry.type);
+        item.insert(QStringLiteral("version"), entry.version);
+        item.insert(QStringLiteral("mdns"), entry.mdns);
+        item.insert(QStringLiteral("translations"), QCborArray::fromStringList(entry.translations));
+        item.insert(QStringLiteral("metadata"), QCborMap::fromJsonObject(entry.metaData));
+        plugins.insert(iter.key(), item);
+    }
+
+    QCborMap index;
+    index.insert(QStringLiteral("version"), INDEX_VERSION);
+    index.insert(QStringLiteral("path"), m_pluginPath);
+    index.insert(QStringLiteral("plugins"), plugins);
+
+    QByteArray data = index.toCborValue().toCbor();
+    QSaveFile  file(m_indexPath);
+    file.setDirectWriteFallback(true);
+    if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.commit()) {
+        qCWarning(CLASS_LC) << "Error writing plugin index" << m_indexPath << ":" << file.errorString();
+        return false;
+    }
+
+    qCDebug(CLASS_LC) << "Plugin index written:" << m_indexPath;
+    return true;
+}
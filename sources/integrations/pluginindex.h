@@ -0,0 +1,97 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2020 Markus Zehnder <business@markuszehnder.ch>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+
+#pragma once
+
+#include <QHash>
+#include <QJsonObject>
+#include <QString>
+#include <QStringList>
+
+/**
+ * @brief PluginIndex is a persistent index of the integration plugin metadata: name (integration type), version, mdns
+ * service type, translations and the complete metadata object of every file in the plugin directory.
+ * Entries are keyed by file path, size and modification time. A refresh only opens new or changed files with
+ * QPluginLoader, the index is stored as CBOR file and rewritten if it changed.
+ * Lookups by integration type and by mdns service type are O(1).
+ */
+class PluginIndex {
+ public:
+    PluginIndex(const QString &pluginPath, const QString &indexFilePath);
+
+    /**
+     * @brief Loads the stored index and updates it with the current content of the plugin directory.
+     * @return true if the plugin directory changed since the index has been stored
+     */
+    bool refresh();
+
+    /**
+     * @brief Returns the lower case integration types of all plugins.
+     */
+    QStringList types() const { return m_types; }
+
+    bool contains(const QString &type) const { return m_byType.contains(type); }
+
+    /**
+     * @brief Returns the "MetaData" object of the plugin, an empty object if unknown.
+     */
+    QJsonObject metaData(const QString &type) const;
+
+    QString fileName(const QString &type) const;
+    QString mdns(const QString &type) const;
+
+    /**
+     * @brief Returns the mdns service types of all plugins, empty strings for plugins without discovery.
+     */
+    QStringList mdnsList() const;
+
+    /**
+     * @brief Returns the integration type of the plugin announcing the mdns service type.
+     */
+    QString typeByMdns(const QString &mdns) const { return m_typeByMdns.value(mdns); }
+
+ private:
+    struct Entry {
+        qint64      size     = 0;
+        qint64      modified = 0;  // msecs since epoch
+        QString     type;          // empty if the file is not a plugin
+        QString     version;
+        QString     mdns;
+        QStringList translations;
+        QJsonObject metaData;
+    };
+
+    bool load();
+    bool save() const;
+    void updateLookups();
+
+    static Entry readPlugin(const QString &path, qint64 size, qint64 modified);
+
+    QString m_pluginPath;
+    QString m_indexPath;
+
+    QHash<QString, Entry>   m_entries;  // file path -> entry, non-plugin files are indexed too
+    QHash<QString, QString> m_byType;   // integration type -> file path
+    QHash<QString, QString> m_typeByMdns;
+    QStringList             m_types;
+};
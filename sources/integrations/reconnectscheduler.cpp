@@ -0,0 +1,260 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2020 Markus Zehnder <business@markuszehnder.ch>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+
+#include "reconnectscheduler.h"
+
+#include <QLoggingCategory>
+#include <QRandomGenerator>
+#include <QtDebug>
+#include <algorithm>
+
+#include "../config.h"
+#include "../entities/entities.h"
+#include "../hardware/hardwarefactory.h"
+#include "../hardware/wifi_control.h"
+#include "integrations.h"
+
+static Q_LOGGING_CATEGORY(CLASS_LC, "plugin.reconnect");
+
+static IntegrationInterface *integrationById(const QString &integrationId) {
+    return qobject_cast<IntegrationInterface *>(Integrations::getInstance()->get(integrationId));
+}
+
+ReconnectScheduler::ReconnectScheduler(QObject *parent) : QObject(parent) {
+    m_clock.start();
+    m_timer.setSingleShot(true);
+    connect(&m_timer, &QTimer::timeout, this, &ReconnectScheduler::onTimer);
+}
+
+void ReconnectScheduler::init() {
+    if (m_initialized) {
+        return;
+    }
+    m_initialized = true;
+
+    // Entities and the hardware are created after Integrations
+    connect(Entities::getInstance(), &Entities::integrationConnectionChanged, this,
+            &ReconnectScheduler::onIntegrationConnected);
+
+    HardwareFactory *hwFactory = HardwareFactory::instance();
+    if (hwFactory && hwFactory->getWifiControl()) {
+        connect(hwFactory->getWifiControl(), &WifiControl::connected, this, &ReconnectScheduler::pump);
+        connect(hwFactory->getWifiControl(), &WifiControl::wifiStatusChanged, this, &ReconnectScheduler::pump);
+    }
+}
+
+void ReconnectScheduler::connectAll() {
+    init();
+    cancel();
+    schedule(Integrations::getInstance()->listIds());
+}
+
+void ReconnectScheduler::connectIntegration(const QString &integrationId) {
+    init();
+    if (m_scheduled.contains(integrationId)) {
+        return;
+    }
+    schedule({integrationId});
+}
+
+void ReconnectScheduler::cancel() {
+    m_timer.stop();
+    m_queue.clear();
+    m_backoff.clear();
+    m_connecting.clear();
+    m_scheduled.clear();
+    m_attempts.clear();
+    m_networkWaitStart = -1;
+}
+
+QVariantMap ReconnectScheduler::statistics() const {
+    QVariantMap wakeToUsable;
+    for (auto iter = m_wakeToUsable.cbegin(); iter != m_wakeToUsable.cend(); ++iter) {
+        wakeToUsable.insert(iter.key(), iter.value().toVariantMap());
+    }
+
+    QVariantMap stats;
+    stats.insert("network_wait", m_networkWait.toVariantMap());
+    stats.insert("wake_to_usable", wakeToUsable);
+    stats.insert("retries", m_retries);
+    stats.insert("pending", QStringList(m_scheduled.keys()));
+    return stats;
+}
+
+void ReconnectScheduler::resetStatistics() {
+    m_networkWait.reset();
+    m_wakeToUsable.clear();
+    m_retries = 0;
+}
+
+void ReconnectScheduler::onIntegrationConnected(const QString &integrationId, bool connected) {
+    // failures are detected with the connect timeout: integrations also report disconnected while connecting
+    if (!connected || !m_scheduled.contains(integrationId)) {
+        return;
+    }
+
+    qint64 latency = m_clock.elapsed() - m_scheduled.take(integrationId);
+    m_wakeToUsable[integrationId].record(latency * 1000);
+    qCInfo(CLASS_LC) << "Integration" << integrationId << "usable after" << latency << "ms, attempts:"
+                     << m_attempts.value(integrationId) + 1;
+
+    m_connecting.remove(integrationId);
+    m_attempts.remove(integrationId);
+    pump();
+}
+
+void ReconnectScheduler::schedule(const QStringList &integrationIds) {
+    qint64 now = m_clock.elapsed();
+    for (const QString &id : integrationIds) {
+        m_scheduled.insert(id, now);
+    }
+    m_queue.append(prioritize(integrationIds));
+    pump();
+}
+
+void ReconnectScheduler::pump() {
+    if (m_queue.isEmpty() && m_connecting.isEmpty() && m_backoff.isEmpty()) {
+        return;
+    }
+
+    qint64 now = m_clock.elapsed();
+    if (!networkReady()) {
+        if (m_networkWaitStart < 0) {
+            qCDebug(CLASS_LC) << "Waiting for wifi connectivity";
+            m_networkWaitStart = now;
+        }
+        return;
+    }
+    if (m_networkWaitStart >= 0) {
+        m_networkWait.record((now - m_networkWaitStart) * 1000);
+        m_networkWaitStart = -1;
+    }
+
+    while (m_connecting.size() < MAX_CONNECTING && !m_queue.isEmpty()) {
+        QString               id          = m_queue.takeFirst();
+        IntegrationInterface *integration = integrationById(id);
+        if (!integration) {
+            m_scheduled.remove(id);
+            continue;
+        }
+
+        qCDebug(CLASS_LC) << "Connecting integration" << id;
+        m_connecting.insert(id, now);
+        IntegrationThreads::post(integration, [](IntegrationInterface *ii) { ii->connect(); });
+    }
+
+    // next connect timeout or backoff
+    qint64 next = -1;
+    for (qint64 started : qAsConst(m_connecting)) {
+        if (next < 0 || started + CONNECT_TIMEOUT < next) {
+            next = started + CONNECT_TIMEOUT;
+        }
+    }
+    if (!m_backoff.isEmpty() && (next < 0 || m_backoff.firstKey() < next)) {
+        next = m_backoff.firstKey();
+    }
+    if (next >= 0) {
+        m_timer.start(static_cast<int>(qMax<qint64>(0, next - now)));
+    }
+}
+
+void ReconnectScheduler::onTimer() {
+    qint64 now = m_clock.elapsed();
+
+    QStringList timedOut;
+    for (auto iter = m_connecting.cbegin(); iter != m_connecting.cend(); ++iter) {
+        if (iter.value() + CONNECT_TIMEOUT <= now) {
+            timedOut.append(iter.key());
+        }
+    }
+    for (const QString &id : timedOut) {
+        m_connecting.remove(id);
+        retry(id);
+    }
+
+    QStringList due;
+    while (!m_backoff.isEmpty() && m_backoff.firstKey() <= now) {
+        due.append(m_backoff.take(m_backoff.firstKey()));
+    }
+    m_queue.append(prioritize(due));
+
+    pump();
+}
+
+void ReconnectScheduler::retry(const QString &integrationId) {
+    int attempt = ++m_attempts[integrationId];
+    m_retries++;
+
+    // equal jitter: half of the exponential delay is fixed, the other half random
+    int delay = static_cast<int>(qMin<qint64>(BACKOFF_MAX, static_cast<qint64>(BACKOFF_MIN) << qMin(attempt - 1, 16)));
+    delay     = delay / 2 + QRandomGenerator::global()->bounded(delay / 2 + 1);
+
+    qCWarning(CLASS_LC) << "Integration" << integrationId << "not connected after" << CONNECT_TIMEOUT
+                        << "ms, retry in" << delay << "ms";
+
+    IntegrationInterface *integration = integrationById(integrationId);
+    if (!integration) {
+        m_scheduled.remove(integrationId);
+        return;
+    }
+    IntegrationThreads::post(integration, [](IntegrationInterface *ii) { ii->disconnect(); });
+    m_backoff.insert(m_clock.elapsed() + delay, integrationId);
+}
+
+bool ReconnectScheduler::networkReady() const {
+    HardwareFactory *hwFactory = HardwareFactory::instance();
+    if (!hwFactory || !hwFactory->getWifiControl()) {
+        return true;
+    }
+    WifiControl *wifi = hwFactory->getWifiControl();
+    // connected is reported before DHCP has settled
+    return wifi->isConnected() && !wifi->wifiStatus().ipAddress().isEmpty();
+}
+
+QStringList ReconnectScheduler::prioritize(const QStringList &integrationIds) const {
+    Config *  config   = Config::getInstance();
+    Entities *entities = Entities::getInstance();
+
+    // entities visible on the current profile: favorites and the groups of its pages
+    QStringList visible = config->profileFavorites();
+    for (const QString &pageId : config->getProfilePages()) {
+        for (const QString &groupId : config->getPage(pageId).value("groups").toStringList()) {
+            visible.append(config->getGroup(groupId).value("entities").toStringList());
+        }
+    }
+
+    QHash<QString, int> visibleCount;
+    for (const QString &entityId : qAsConst(visible)) {
+        Entity *entity = qobject_cast<Entity *>(entities->get(entityId));
+        if (entity) {
+            visibleCount[entity->integration()]++;
+        }
+    }
+
+    // stable: integrations without visible entities keep their order
+    QStringList ordered = integrationIds;
+    std::stable_sort(ordered.begin(), ordered.end(), [&visibleCount](const QString &a, const QString &b) {
+        return visibleCount.value(a) > visibleCount.value(b);
+    });
+    return ordered;
+}
@@ -0,0 +1,105 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2020 Markus Zehnder <business@markuszehnder.ch>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+
+#pragma once
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMultiMap>
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+#include <QVariantMap>
+
+#include "../latencyhistogram.h"
+
+/**
+ * @brief ReconnectScheduler connects the integrations after startup and after a wakeup from WIFI_OFF without a
+ * thundering herd of handshakes: it waits until wifi is connected with an IP address, connects the integrations with
+ * entities on the current profile first and has at most MAX_CONNECTING connects in flight.
+ * An integration counts as connected when it reports its entities connected. If it doesn't within CONNECT_TIMEOUT, it
+ * is reconnected with jittered exponential backoff. Once connected, reconnects are up to the integration.
+ * The latency from scheduling to the first usable entity is recorded per integration.
+ */
+class ReconnectScheduler : public QObject {
+    Q_OBJECT
+
+ public:
+    explicit ReconnectScheduler(QObject* parent = nullptr);
+
+    /**
+     * @brief Connects all integrations, pending connects are rescheduled.
+     */
+    void connectAll();
+
+    /**
+     * @brief Connects a single integration, e.g. one created after the entities have been loaded.
+     */
+    void connectIntegration(const QString& integrationId);
+
+    /**
+     * @brief Drops all pending connects, e.g. when wifi is turned off.
+     */
+    void cancel();
+
+    /**
+     * @brief Returns the network wait and the wake to usable latencies per integration in microseconds, and the number
+     * of retries.
+     */
+    QVariantMap statistics() const;
+    void        resetStatistics();
+
+ public slots:  // NOLINT open issue: https://github.com/cpplint/cpplint/pull/99
+    // the entities of an integration changed their connection state
+    void onIntegrationConnected(const QString& integrationId, bool connected);
+
+ private:
+    void init();
+    void schedule(const QStringList& integrationIds);
+    void pump();
+    void onTimer();
+    void retry(const QString& integrationId);
+    bool networkReady() const;
+
+    QStringList prioritize(const QStringList& integrationIds) const;
+
+    static const int MAX_CONNECTING = 2;
+    static const int CONNECT_TIMEOUT = 10000;
+    static const int BACKOFF_MIN = 1000;
+    static const int BACKOFF_MAX = 60000;
+
+    bool          m_initialized = false;
+    QElapsedTimer m_clock;
+    QTimer        m_timer;
+    qint64        m_networkWaitStart = -1;  // waiting for wifi since
+
+    QStringList                m_queue;       // ready to connect, in priority order
+    QMultiMap<qint64, QString> m_backoff;     // due time -> integration id
+    QHash<QString, qint64>     m_connecting;  // integration id -> connect time
+    QHash<QString, qint64>     m_scheduled;   // integration id -> scheduling time, until connected
+    QHash<QString, int>        m_attempts;
+
+    LatencyHistogram                 m_networkWait;
+    QHash<QString, LatencyHistogram> m_wakeToUsable;
+    quint32                          m_retries = 0;
+};
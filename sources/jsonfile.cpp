@@ -23,14 +23,27 @@
 
 #include "jsonfile.h"
 
+#include <QDateTime>
 #include <QDir>
 #include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
 #include <QJsonDocument>
+#include <QJsonObject>
 #include <QLoggingCategory>
+#include <QMutex>
+#include <QRegularExpression>
+#include <QSaveFile>
 #include <QUrl>
 #include <QtDebug>
 
+#if defined(Q_OS_UNIX)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #include <iostream>
+#include <memory>
 #include <string>
 
 #include <valijson/adapters/qtjson_adapter.hpp>
@@ -40,6 +53,8 @@
 #include <valijson/validation_results.hpp>
 #include <valijson/validator.hpp>
 
+#include "configutil.h"
+
 using std::endl;
 
 using valijson::Schema;
@@ -50,6 +65,248 @@ using valijson::adapters::QtJsonAdapter;
 
 static Q_LOGGING_CATEGORY(CLASS_LC, "json");
 
+namespace {
+
+/**
+ * @brief Parsed JSON schema file. Sub-schemas are compiled on first use. Shared between all JsonFile instances.
+ */
+struct CompiledSchema {
+    QDateTime                                     lastModified;
+    qint64                                        size = 0;
+    QJsonObject                                   document;
+    std::shared_ptr<const Schema>                 root;
+    QHash<QString, std::shared_ptr<const Schema>> subschemas;  // key: schema location, e.g. /properties/settings
+};
+
+QMutex                                          s_schemaMutex;
+QHash<QString, std::shared_ptr<CompiledSchema>> s_schemaCache;  // key: schema file path
+
+std::shared_ptr<const Schema> parseSchema(const QJsonObject &schemaObject) {
+    auto          schema = std::make_shared<Schema>();
+    SchemaParser  parser;
+    QtJsonAdapter schemaAdapter(schemaObject);
+    parser.populateSchema(schemaAdapter, *schema);
+    return schema;
+}
+
+/**
+ * @brief Returns the parsed schema file. The schema file is only parsed again if its modification time or size
+ * changed.
+ */
+std::shared_ptr<CompiledSchema> compiledSchema(const QString &path, QString *errorText) {
+    QFileInfo    info(path);
+    QMutexLocker locker(&s_schemaMutex);
+
+    std::shared_ptr<CompiledSchema> compiled = s_schemaCache.value(path);
+    if (compiled && compiled->lastModified == info.lastModified() && compiled->size == info.size()) {
+        return compiled;
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        *errorText = JsonFile::tr("cannot open file '%1' for reading: %2").arg(path).arg(file.errorString());
+        qCWarning(CLASS_LC) << *errorText;
+        return nullptr;
+    }
+    QJsonParseError error;
+    QJsonDocument   doc = QJsonDocument::fromJson(file.readAll(), &error);
+    if (error.error != QJsonParseError::NoError) {
+        *errorText = JsonFile::tr("invalid JSON file '%1' at offset %2").arg(error.errorString()).arg(error.offset);
+        qCCritical(CLASS_LC) << *errorText;
+        return nullptr;
+    }
+
+    compiled = std::make_shared<CompiledSchema>();
+    compiled->lastModified = info.lastModified();
+    compiled->size = info.size();
+    compiled->document = doc.object();
+    compiled->root = parseSchema(compiled->document);
+    s_schemaCache.insert(path, compiled);
+
+    qCDebug(CLASS_LC) << "Parsed JSON schema:" << path;
+    return compiled;
+}
+
+QString escapePointerToken(QString token) { return token.replace('~', "~0").replace('/', "~1"); }
+
+/**
+ * @brief Returns true if the schema or any of its sub-schemas contains a reference. References are relative to the
+ * schema document and can't be resolved in a sub-schema compiled on its own.
+ */
+bool containsReference(const QJsonValue &schema) {
+    if (schema.isObject()) {
+        QJsonObject object = schema.toObject();
+        if (object.contains("$ref")) {
+            return true;
+        }
+        for (const QJsonValue &value : object) {
+            if (containsReference(value)) {
+                return true;
+            }
+        }
+    } else if (schema.isArray()) {
+        for (const QJsonValue &value : schema.toArray()) {
+            if (containsReference(value)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Walks the schema along the document path and returns the sub-schema describing the referenced value.
+ * @return false if the location cannot be validated on its own: references on the path or within the sub-schema,
+ * schema composition and tuple arrays are not resolved, and unexpected properties are left to the full document
+ * validation.
+ */
+bool resolveSubschema(const QJsonObject &root, const QStringList &tokens, QJsonObject *subschema, QString *location) {
+    QJsonObject schema = root;
+    location->clear();
+
+    for (const QString &token : tokens) {
+        if (schema.contains("$ref") || schema.contains("allOf") || schema.contains("anyOf") ||
+            schema.contains("oneOf")) {
+            return false;
+        }
+
+        QJsonObject properties = schema.value("properties").toObject();
+        QJsonValue  items = schema.value("items");
+        QJsonValue  additional = schema.value("additionalProperties");
+
+        if (properties.contains(token)) {
+            schema = properties.value(token).toObject();
+            location->append("/properties/" + escapePointerToken(token));
+            continue;
+        }
+        if (items.isObject()) {
+            schema = items.toObject();
+            location->append("/items");
+            continue;
+        }
+        if (items.isArray()) {
+            return false;
+        }
+
+        bool        matched = false;
+        QJsonObject patterns = schema.value("patternProperties").toObject();
+        for (auto it = patterns.constBegin(); it != patterns.constEnd(); ++it) {
+            if (QRegularExpression(it.key()).match(token).hasMatch()) {
+                schema = it.value().toObject();
+                location->append("/patternProperties/" + escapePointerToken(it.key()));
+                matched = true;
+                break;
+            }
+        }
+        if (matched) {
+            continue;
+        }
+
+        if (additional.isObject()) {
+            schema = additional.toObject();
+            location->append("/additionalProperties");
+        } else if (additional.isBool() && !additional.toBool()) {
+            return false;
+        } else {
+            // unconstrained value
+            schema = QJsonObject();
+            location->append("/*");
+        }
+    }
+
+    if (containsReference(schema)) {
+        return false;
+    }
+
+    *subschema = schema;
+    return true;
+}
+
+/**
+ * @brief Returns the compiled sub-schema for the document path or nullptr if it cannot be resolved.
+ */
+std::shared_ptr<const Schema> subschema(const std::shared_ptr<CompiledSchema> &compiled, const QStringList &tokens) {
+    if (tokens.isEmpty()) {
+        return compiled->root;
+    }
+
+    QJsonObject schemaObject;
+    QString     location;
+    if (!resolveSubschema(compiled->document, tokens, &schemaObject, &location)) {
+        return nullptr;
+    }
+
+    QMutexLocker                  locker(&s_schemaMutex);
+    std::shared_ptr<const Schema> schema = compiled->subschemas.value(location);
+    if (!schema) {
+        schema = parseSchema(schemaObject);
+        compiled->subschemas.insert(location, schema);
+    }
+    return schema;
+}
+
+bool valueByPointer(const QJsonValue &root, const QStringList &tokens, QJsonValue *value) {
+    QJsonValue current = root;
+    for (const QString &token : tokens) {
+        if (current.isObject()) {
+            QJsonObject object = current.toObject();
+            auto        it = object.constFind(token);
+            if (it == object.constEnd()) {
+                return false;
+            }
+            current = it.value();
+        } else if (current.isArray()) {
+            bool ok;
+            int  index = token.toInt(&ok);
+            if (!ok || index < 0 || index >= current.toArray().size()) {
+                return false;
+            }
+            current = current.toArray().at(index);
+        } else {
+            return false;
+        }
+    }
+    *value = current;
+    return true;
+}
+
+QJsonValue rootValue(const QJsonDocument &doc) {
+    return doc.isObject() ? QJsonValue(doc.object()) : doc.isArray() ? QJsonValue(doc.array()) : QJsonValue();
+}
+
+bool validateValue(const Schema &schema, const QJsonValue &value, const QString &path,
+                   QString &errorText) {  // NOLINT we do not want a pointer for errorText
+    Validator         validator;
+    ValidationResults results;
+    QtJsonAdapter     targetDocumentAdapter(value);
+    if (validator.validate(schema, targetDocumentAdapter, &results)) {
+        return true;
+    }
+
+    std::ostringstream err;
+    if (path.isEmpty()) {
+        err << "Validation failed." << endl;
+    } else {
+        err << "Validation failed at '" << path.toStdString() << "'." << endl;
+    }
+    ValidationResults::Error error;
+    unsigned int             errorNum = 1;
+    while (results.popError(error)) {
+        err << "Error #" << errorNum << std::endl;
+        err << "  ";
+        for (const std::string &contextElement : error.context) {
+            err << contextElement << " ";
+        }
+        err << endl;
+        err << "    - " << error.description << endl;
+        ++errorNum;
+    }
+    errorText = QString::fromStdString(err.str());
+    return false;
+}
+
+}  // namespace
+
 JsonFile::JsonFile(QObject *parent) : QObject(parent) {}
 
 JsonFile::JsonFile(const QString &path, const QString &schemaPath, QObject *parent)
@@ -73,7 +330,9 @@ bool JsonFile::rename(const QString &newName) {
     return success;
 }
 
-bool JsonFile::write(const QVariantMap &data) {
+bool JsonFile::write(const QVariantMap &data) { return write(data, QStringList(QString())); }
+
+bool JsonFile::write(const QVariantMap &data, const QStringList &validationPaths) {
     m_error.clear();
     if (m_file.fileName().isEmpty()) {
         qCWarning(CLASS_LC) << "Not writing json file: no filename set!";
@@ -87,24 +346,52 @@ bool JsonFile::write(const QVariantMap &data) {
         return false;
     }
 
-    if (!validate(doc, m_error)) {
+    if (!validationPaths.isEmpty() && !validate(doc, validationPaths, m_error)) {
         qCWarning(CLASS_LC) << "JSON document failed schema validation before writing:" << m_file.fileName();
         return false;
     }
 
     QByteArray json = doc.toJson();
-    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
-        m_error = tr("cannot open file '%1' for writing: %2").arg(m_file.fileName()).arg((m_file.errorString()));
+
+    // Write to a temporary file and rename it over the existing file: a crash or power loss never leaves a truncated
+    // file behind.
+    QSaveFile file(m_file.fileName());
+    file.setDirectWriteFallback(true);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        m_error = tr("cannot open file '%1' for writing: %2").arg(m_file.fileName()).arg((file.errorString()));
         qCWarning(CLASS_LC) << m_error;
         return false;
     }
-    bool success = m_file.write(json) == json.size();
-    m_file.close();
-    if (!success) {
-        m_error = m_file.errorString();
+    if (file.write(json) != json.size() || !file.flush()) {
+        m_error = file.errorString();
+        file.cancelWriting();
         qCWarning(CLASS_LC) << "Error writing json file:" << m_error;
+        return false;
     }
-    return success;
+#if defined(Q_OS_UNIX)
+    if (::fsync(file.handle()) != 0) {
+        qCWarning(CLASS_LC) << "fsync failed for:" << m_file.fileName();
+    }
+#endif
+    if (!file.commit()) {
+        m_error = file.errorString();
+        qCWarning(CLASS_LC) << "Error committing json file:" << m_error;
+        return false;
+    }
+    syncDirectory();
+
+    return true;
+}
+
+void JsonFile::syncDirectory() {
+#if defined(Q_OS_UNIX)
+    // persist the rename operation
+    int fd = ::open(QFile::encodeName(QFileInfo(m_file).absolutePath()).constData(), O_RDONLY);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+#endif
 }
 
 QVariant JsonFile::read() {
@@ -155,50 +442,81 @@ bool JsonFile::loadDocument(const QString &path, QJsonDocument &doc) {
 }
 
 bool JsonFile::validate(const QJsonDocument &doc, QString &errorText) {
+    return validate(doc, QStringList(QString()), errorText);
+}
+
+bool JsonFile::validate(const QJsonDocument &doc, const QStringList &paths, QString &errorText) {
     if (m_schemaPath.isEmpty()) {
         qCDebug(CLASS_LC) << "Skipping json document schema validation: no schema file set";
         return true;
     }
 
-    // TODO(zehnm) in case there are too many read or write calls we should probably cache the schema document
-    QJsonDocument schemaDoc;
-    if (!loadDocument(m_schemaPath, schemaDoc)) {
+    std::shared_ptr<CompiledSchema> compiled = compiledSchema(m_schemaPath, &errorText);
+    if (!compiled) {
         return false;
     }
 
-    return JsonFile::validate(doc, schemaDoc, errorText);
-}
+    QJsonValue root = rootValue(doc);
+    for (const QString &path : paths) {
+        bool        ok;
+        QStringList tokens = ConfigUtil::jsonPointerTokens(path, &ok);
+        if (!ok) {
+            errorText = tr("invalid JSON pointer '%1'").arg(path);
+            return false;
+        }
 
-bool JsonFile::validate(const QJsonDocument &doc, const QJsonDocument &schemaDoc, QString &errorText) {
-    // Parse JSON schema content using valijson
-    Schema        schema;
-    SchemaParser  parser;
-    QtJsonAdapter schemaAdapter(schemaDoc.object());
-    parser.populateSchema(schemaAdapter, schema);
+        // A removed subtree changes the keys of its container: required and additionalProperties of the enclosing
+        // schemas are only checked by the full validation.
+        QJsonValue value;
+        if (!valueByPointer(root, tokens, &value)) {
+            qCDebug(CLASS_LC) << "Removed value" << path << ": validating the whole document";
+            return validateValue(*compiled->root, root, QString(), errorText);
+        }
 
-    // Perform validation
-    Validator         validator;
-    ValidationResults results;
-    QtJsonAdapter     targetDocumentAdapter(doc.isObject() ? QJsonValue(doc.object())
-                                                       : doc.isArray() ? QJsonValue(doc.array()) : QJsonValue());
-    if (!validator.validate(schema, targetDocumentAdapter, &results)) {
-        std::ostringstream err;
-        err << "Validation failed." << endl;
-        ValidationResults::Error error;
-        unsigned int             errorNum = 1;
-        while (results.popError(error)) {
-            err << "Error #" << errorNum << std::endl;
-            err << "  ";
-            for (const std::string &contextElement : error.context) {
-                err << contextElement << " ";
-            }
-            err << endl;
-            err << "    - " << error.description << endl;
-            ++errorNum;
+        std::shared_ptr<const Schema> schema = subschema(compiled, tokens);
+        if (!schema) {
+            qCDebug(CLASS_LC) << "No sub-schema for" << path << ": validating the whole document";
+            return validateValue(*compiled->root, root, QString(), errorText);
+        }
+        if (!validateValue(*schema, value, path, errorText)) {
+            return false;
         }
-        errorText = QString::fromStdString(err.str());
-        return false;
     }
 
     return true;
 }
+
+bool JsonFile::validate(const QJsonValue &value, const QString &path, QString &errorText) {
+    if (m_schemaPath.isEmpty()) {
+        return true;
+    }
+
+    std::shared_ptr<CompiledSchema> compiled = compiledSchema(m_schemaPath, &errorText);
+    if (!compiled) {
+        return false;
+    }
+
+    std::shared_ptr<const Schema> schema = subschema(compiled, ConfigUtil::jsonPointerTokens(path));
+    if (!schema) {
+        qCDebug(CLASS_LC) << "Skipping validation: no sub-schema for" << path;
+        return true;
+    }
+    return validateValue(*schema, value, path, errorText);
+}
+
+bool JsonFile::hasSubschema(const QString &path) {
+    bool        ok;
+    QStringList tokens = ConfigUtil::jsonPointerTokens(path, &ok);
+    if (!ok || m_schemaPath.isEmpty()) {
+        return false;
+    }
+
+    QString                         errorText;
+    std::shared_ptr<CompiledSchema> compiled = compiledSchema(m_schemaPath, &errorText);
+    return compiled && subschema(compiled, tokens);
+}
+
+bool JsonFile::validate(const QJsonDocument &doc, const QJsonDocument &schemaDoc, QString &errorText) {
+    std::shared_ptr<const Schema> schema = parseSchema(schemaDoc.object());
+    return validateValue(*schema, rootValue(doc), QString(), errorText);
+}
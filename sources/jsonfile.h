@@ -24,7 +24,9 @@
 #pragma once
 
 #include <QFile>
+#include <QJsonValue>
 #include <QObject>
+#include <QStringList>
 #include <QVariant>
 
 class JsonFile : public QObject {
@@ -70,9 +72,23 @@ class JsonFile : public QObject {
     }
     Q_INVOKABLE inline bool remove() { return m_file.remove(); }
 
+    /**
+     * @brief write Validates and atomically writes the data to the file: the data is written to a temporary file which
+     * replaces the existing file after it has been synced to disk.
+     * @return true if successful
+     */
     Q_INVOKABLE bool     write(const QVariantMap &data);
     Q_INVOKABLE QVariant read();
 
+    /**
+     * @brief write Atomically writes the data to the file and only validates the given subtrees.
+     * @param data The document to write
+     * @param validationPaths JSON pointers of the changed subtrees. An empty pointer validates the whole document, an
+     * empty list skips validation. A pointer to a removed subtree validates its nearest existing ancestor.
+     * @return true if successful
+     */
+    bool write(const QVariantMap &data, const QStringList &validationPaths);
+
     /**
      * @brief validate Validates the JSON document against the associated schema of the JsonFile instance.
      * @param doc The JSON document to validate
@@ -81,6 +97,33 @@ class JsonFile : public QObject {
      */
     bool validate(const QJsonDocument &doc, QString &errorText);  // NOLINT we do not want a pointer for errorText
 
+    /**
+     * @brief validate Validates only the given subtrees of the JSON document against their sub-schemas.
+     * Falls back to validating the whole document if a sub-schema cannot be resolved or a subtree has been removed.
+     * @param doc The JSON document to validate
+     * @param paths JSON pointers of the subtrees to validate
+     * @param errorText Returns the validation error text
+     * @return true if the subtrees are valid according to the schema
+     */
+    bool validate(const QJsonDocument &doc, const QStringList &paths,
+                  QString &errorText);  // NOLINT we do not want a pointer for errorText
+
+    /**
+     * @brief validate Validates a JSON value against the sub-schema of the given location in the document.
+     * @param value The JSON value to validate
+     * @param path JSON pointer of the value's location in the document
+     * @param errorText Returns the validation error text
+     * @return true if the value is valid. Also true if the sub-schema cannot be resolved, see hasSubschema.
+     */
+    bool validate(const QJsonValue &value, const QString &path,
+                  QString &errorText);  // NOLINT we do not want a pointer for errorText
+
+    /**
+     * @brief hasSubschema Returns true if the sub-schema for the given document location can be resolved and the
+     * location can be validated on its own.
+     */
+    bool hasSubschema(const QString &path);
+
     /**
      * @brief validate Validates the JSON document against the given JSON schema.
      * @param doc The JSON document to validate
@@ -103,6 +146,7 @@ class JsonFile : public QObject {
 
  private:
     bool loadDocument(const QString &path, QJsonDocument &doc);  // NOLINT we do not want a pointer for doc
+    void syncDirectory();
 
     QFile   m_file;
     QString m_schemaPath;
@@ -0,0 +1,236 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2020 Markus Zehnder <business@markuszehnder.ch>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+
+#include "jsonpatch.h"
+
+#include "configutil.h"
+
+bool JsonPatch::mergePatch(QVariant *document, const QVariant &patch, const QString &path, QStringList *changedPaths,
+                           QString *error) {
+    if (path.isEmpty()) {
+        mergeValue(document, patch, path, changedPaths);
+        return true;
+    }
+
+    bool     found;
+    QVariant target = ConfigUtil::getValueByPointer(*document, path, &found);
+    if (!found) {
+        *error = QString("path not found: %1").arg(path);
+        return false;
+    }
+
+    mergeValue(&target, patch, path, changedPaths);
+    return modify(document, ConfigUtil::jsonPointerTokens(path), Operation::Replace, target, nullptr, error);
+}
+
+void JsonPatch::mergeValue(QVariant *target, const QVariant &patch, const QString &path, QStringList *changedPaths) {
+    if (patch.type() != QVariant::Map) {
+        *target = patch;
+        changedPaths->append(path);
+        return;
+    }
+
+    QVariantMap map = target->type() == QVariant::Map ? target->toMap() : QVariantMap();
+    if (target->type() != QVariant::Map) {
+        changedPaths->append(path);
+    }
+
+    QVariantMap patchMap = patch.toMap();
+    for (auto it = patchMap.cbegin(); it != patchMap.cend(); ++it) {
+        QString memberPath = path + ConfigUtil::jsonPointer({it.key()});
+        if (isNull(it.value())) {
+            if (map.remove(it.key()) > 0) {
+                // removing a member might violate constraints of the containing object
+                changedPaths->append(path);
+            }
+        } else {
+            QVariant member = map.value(it.key());
+            mergeValue(&member, it.value(), memberPath, changedPaths);
+            map.insert(it.key(), member);
+        }
+    }
+
+    *target = map;
+}
+
+bool JsonPatch::apply(QVariant *document, const QVariantList &operations, QStringList *changedPaths,
+                      QString *error) {
+    // work on a copy: the document is only modified if all operations succeed
+    QVariant    result = *document;
+    QStringList changed;
+
+    for (int i = 0; i < operations.size(); i++) {
+        QVariantMap operation = operations.at(i).toMap();
+        QString     op = operation.value("op").toString();
+        QString     path = operation.value("path").toString();
+        QString     from = operation.value("from").toString();
+        bool        ok;
+        QStringList tokens = ConfigUtil::jsonPointerTokens(path, &ok);
+
+        if (!ok || !operation.contains("path")) {
+            *error = QString("operation %1: invalid path '%2'").arg(i).arg(path);
+            return false;
+        }
+
+        QString opError;
+        if (op == "add") {
+            ok = modify(&result, tokens, Operation::Add, operation.value("value"), nullptr, &opError);
+            // adding an array element shifts the following elements
+            changed.append(tokens.isEmpty() ? path : ConfigUtil::jsonPointerParent(path));
+        } else if (op == "remove") {
+            ok = modify(&result, tokens, Operation::Remove, QVariant(), nullptr, &opError);
+            changed.append(ConfigUtil::jsonPointerParent(path));
+        } else if (op == "replace") {
+            ok = modify(&result, tokens, Operation::Replace, operation.value("value"), nullptr, &opError);
+            changed.append(path);
+        } else if (op == "move" || op == "copy") {
+            QVariant value;
+            if (from.isEmpty() && op == "move") {
+                ok = false;
+                opError = "cannot move the whole document";
+            } else if (op == "move" && (path == from || path.startsWith(from + "/"))) {
+                ok = path == from;
+                opError = "cannot move a value into one of its children";
+            } else if (op == "move") {
+                ok = modify(&result, ConfigUtil::jsonPointerTokens(from), Operation::Remove, QVariant(), &value,
+                            &opError);
+                changed.append(ConfigUtil::jsonPointerParent(from));
+            } else {
+                value = ConfigUtil::getValueByPointer(result, from, &ok);
+                if (!ok) {
+                    opError = QString("path not found: %1").arg(from);
+                }
+            }
+            if (ok && path != from) {
+                ok = modify(&result, tokens, Operation::Add, value, nullptr, &opError);
+                changed.append(tokens.isEmpty() ? path : ConfigUtil::jsonPointerParent(path));
+            }
+        } else if (op == "test") {
+            QVariant value = ConfigUtil::getValueByPointer(result, path, &ok);
+            if (!ok) {
+                opError = QString("path not found: %1").arg(path);
+            } else if (value != operation.value("value")) {
+                ok = false;
+                opError = QString("test failed: %1").arg(path);
+            }
+        } else {
+            ok = false;
+            opError = QString("unsupported operation '%1'").arg(op);
+        }
+
+        if (!ok) {
+            *error = QString("operation %1: %2").arg(i).arg(opError);
+            return false;
+        }
+    }
+
+    *document = result;
+    for (const QString &path : changed) {
+        if (!changedPaths->contains(path)) {
+            changedPaths->append(path);
+        }
+    }
+    return true;
+}
+
+bool JsonPatch::isNull(const QVariant &value) {
+    return !value.isValid() || value.isNull() || value.userType() == QMetaType::Nullptr;
+}
+
+bool JsonPatch::modify(QVariant *node, QStringList tokens, Operation operation, const QVariant &value,
+                       QVariant *removed, QString *error) {
+    if (tokens.isEmpty()) {
+        if (operation == Operation::Remove) {
+            *error = "cannot remove the whole document";
+            return false;
+        }
+        *node = value;
+        return true;
+    }
+
+    QString token = tokens.takeFirst();
+
+    if (node->type() == QVariant::Map) {
+        QVariantMap map = node->toMap();
+        auto        it = map.find(token);
+
+        if (!tokens.isEmpty()) {
+            if (it == map.end()) {
+                *error = QString("path not found: %1").arg(token);
+                return false;
+            }
+            if (!modify(&it.value(), tokens, operation, value, removed, error)) {
+                return false;
+            }
+        } else if (operation == Operation::Add) {
+            map.insert(token, value);
+        } else if (it == map.end()) {
+            *error = QString("path not found: %1").arg(token);
+            return false;
+        } else if (operation == Operation::Replace) {
+            it.value() = value;
+        } else {
+            if (removed) {
+                *removed = it.value();
+            }
+            map.erase(it);
+        }
+
+        *node = map;
+        return true;
+    }
+
+    if (node->type() == QVariant::List || node->type() == QVariant::StringList) {
+        QVariantList list = node->toList();
+        bool         insert = operation == Operation::Add && tokens.isEmpty();
+        // "-" references the position after the last element
+        bool ok = insert && token == "-";
+        int  index = ok ? list.size() : token.toInt(&ok);
+
+        if (!ok || index < 0 || index >= (insert ? list.size() + 1 : list.size())) {
+            *error = QString("invalid array index: %1").arg(token);
+            return false;
+        }
+
+        if (!tokens.isEmpty()) {
+            if (!modify(&list[index], tokens, operation, value, removed, error)) {
+                return false;
+            }
+        } else if (operation == Operation::Add) {
+            list.insert(index, value);
+        } else if (operation == Operation::Replace) {
+            list[index] = value;
+        } else {
+            if (removed) {
+                *removed = list.at(index);
+            }
+            list.removeAt(index);
+        }
+
+        *node = list;
+        return true;
+    }
+
+    *error = QString("path not found: %1").arg(token);
+    return false;
+}
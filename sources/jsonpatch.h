@@ -0,0 +1,72 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2020 Markus Zehnder <business@markuszehnder.ch>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+
+/**
+ * @brief The JsonPatch class modifies QVariantMap / QVariantList document trees with JSON Merge Patch (RFC 7396) and
+ * JSON Patch (RFC 6902) documents. The JSON pointers of the modified subtrees are returned, so only these subtrees
+ * have to be validated.
+ */
+class JsonPatch {
+ public:
+    /**
+     * @brief Applies a JSON Merge Patch (RFC 7396).
+     * @param document The document to patch
+     * @param patch Merge patch. A null value removes the member, objects are merged recursively, all other values
+     * replace the target value.
+     * @param path JSON pointer of the patched location in the document. Empty for the whole document.
+     * @param changedPaths Returns the JSON pointers of the modified subtrees
+     * @param error Returns the error message
+     * @return false if the path doesn't exist. The document is not modified in this case.
+     */
+    static bool mergePatch(QVariant *document, const QVariant &patch, const QString &path, QStringList *changedPaths,
+                           QString *error);
+
+    /**
+     * @brief Applies a JSON Patch (RFC 6902): an array of add, remove, replace, move, copy and test operations.
+     * The patch is applied atomically: if an operation fails, the document is not modified.
+     * @param document The document to patch
+     * @param operations JSON Patch operations
+     * @param changedPaths Returns the JSON pointers of the modified subtrees
+     * @param error Returns the error message of the failed operation
+     * @return true if all operations were successful
+     */
+    static bool apply(QVariant *document, const QVariantList &operations, QStringList *changedPaths, QString *error);
+
+    /**
+     * @brief Returns true if the value represents a JSON null value.
+     */
+    static bool isNull(const QVariant &value);
+
+ private:
+    enum class Operation { Add, Replace, Remove };
+
+    static bool modify(QVariant *node, QStringList tokens, Operation operation, const QVariant &value,
+                       QVariant *removed, QString *error);
+    static void mergeValue(QVariant *target, const QVariant &patch, const QString &path, QStringList *changedPaths);
+};
@@ -0,0 +1,100 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2020 Markus Zehnder <business@markuszehnder.ch>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+
+#include "latencyhistogram.h"
+
+#include <cmath>
+#include <cstring>
+
+LatencyHistogram::LatencyHistogram() { reset(); }
+
+void LatencyHistogram::record(qint64 usec) {
+    if (usec < 0) {
+        usec = 0;
+    }
+    m_buckets[bucketIndex(usec)]++;
+    m_count++;
+    m_sum += usec;
+    if (usec > m_max) {
+        m_max = usec;
+    }
+}
+
+void LatencyHistogram::reset() {
+    memset(m_buckets, 0, sizeof(m_buckets));
+    m_count = 0;
+    m_sum = 0;
+    m_max = 0;
+}
+
+qint64 LatencyHistogram::percentile(double percentile) const {
+    if (m_count == 0) {
+        return 0;
+    }
+
+    qint64 rank = qMax(static_cast<qint64>(std::ceil(percentile / 100.0 * m_count)), static_cast<qint64>(1));
+    qint64 total = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+        total += m_buckets[i];
+        if (total >= rank) {
+            return qMin(bucketUpperBound(i), m_max);
+        }
+    }
+    return m_max;
+}
+
+QVariantMap LatencyHistogram::toVariantMap() const {
+    QVariantMap map;
+    map.insert("count", m_count);
+    map.insert("avg", average());
+    map.insert("max", m_max);
+    map.insert("p50", percentile(50));
+    map.insert("p90", percentile(90));
+    map.insert("p99", percentile(99));
+    return map;
+}
+
+int LatencyHistogram::bucketIndex(qint64 usec) {
+    // values below SUB_BUCKETS have their own bucket
+    if (usec < SUB_BUCKETS) {
+        return static_cast<int>(usec);
+    }
+
+    int msb = 2;
+    while (msb < 62 && (usec >> (msb + 1)) != 0) {
+        msb++;
+    }
+    // the two bits after the most significant bit select the sub-bucket
+    int index = (msb - 1) * SUB_BUCKETS + static_cast<int>((usec >> (msb - 2)) & (SUB_BUCKETS - 1));
+    return qMin(index, BUCKETS - 1);
+}
+
+qint64 LatencyHistogram::bucketUpperBound(int index) {
+    if (index < SUB_BUCKETS) {
+        return index;
+    }
+
+    int msb = index / SUB_BUCKETS + 1;
+    int sub = index % SUB_BUCKETS;
+    return (static_cast<qint64>(SUB_BUCKETS + sub + 1) << (msb - 2)) - 1;
+}
@@ -0,0 +1,71 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2020 Markus Zehnder <business@markuszehnder.ch>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+
+#pragma once
+
+#include <QVariantMap>
+#include <QtGlobal>
+
+/**
+ * @brief The LatencyHistogram class records latencies in logarithmic buckets with four sub-buckets per power of two.
+ * Percentiles are approximated with a relative error of at most 25% using constant memory and O(1) recording.
+ * The class is not thread safe.
+ */
+class LatencyHistogram {
+ public:
+    LatencyHistogram();
+
+    /**
+     * @brief Records a latency value in microseconds.
+     */
+    void record(qint64 usec);
+
+    void reset();
+
+    qint64 count() const { return m_count; }
+    qint64 max() const { return m_max; }
+    qint64 average() const { return m_count > 0 ? m_sum / m_count : 0; }
+
+    /**
+     * @brief Returns the approximated percentile in microseconds.
+     * @param percentile Percentile between 0 and 100, e.g. 99 for p99
+     */
+    qint64 percentile(double percentile) const;
+
+    /**
+     * @brief Returns count, avg, max, p50, p90 and p99. Latencies are in microseconds.
+     */
+    QVariantMap toVariantMap() const;
+
+ private:
+    static int    bucketIndex(qint64 usec);
+    static qint64 bucketUpperBound(int index);
+
+    static const int SUB_BUCKETS = 4;
+    static const int BUCKETS = 41 * SUB_BUCKETS;  // up to 2^41 us: 25 days
+
+    quint32 m_buckets[BUCKETS];
+    qint64  m_count;
+    qint64  m_sum;
+    qint64  m_max;
+};
@@ -170,6 +170,7 @@ void Logger::processMessage(QtMsgType type, const char* category, const char* so
         if (m_queueEnabled) {
             writeQueue(message);
         }
+        emit messageLogged(type, cat, msg, message.timestamp);
     }
 }
 
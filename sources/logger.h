@@ -94,6 +94,10 @@ class Logger : public QObject {
     void defineLogCategory(const QString& category, int level, QLoggingCategory* loggingCategory = nullptr,
                            PluginInterface* plugin = nullptr);
 
+ signals:
+    // emitted for every written message, possibly from a foreign thread: use a queued connection
+    void messageLogged(int type, const QString& category, const QString& message, uint timestamp);
+
  private:
     struct SCategory {
         explicit SCategory(QtMsgType logLevel, QLoggingCategory* logCategory = nullptr,
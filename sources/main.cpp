@@ -41,6 +41,7 @@
 #include "entities/entities.h"
 #include "environment.h"
 #include "fileio.h"
+#include "frametimemonitor.h"
 #include "hardware/buttonhandler.h"
 #include "hardware/hardwarefactory.h"
 #include "hardware/touchdetect.h"
@@ -104,6 +105,8 @@ int main(int argc, char* argv[]) {
         qCCritical(CLASS_LC).noquote() << "Invalid configuration!" << endl << config->getError();
         configError = true;
     }
+    // write pending configuration changes when leaving the event loop
+    QObject::connect(&app, &QCoreApplication::aboutToQuit, config, &Config::flush);
 
     qmlRegisterUncreatableType<Config>("Config", 1, 0, "Config",
                                        "Not creatable as it is a global object managed from cpp");
@@ -187,7 +190,8 @@ int main(int argc, char* argv[]) {
 
     // INTEGRATIONS
     Integrations* integrations =
-        new Integrations(qEnvironmentVariable(Environment::ENV_YIO_PLUGIN_DIR, appPath + "/plugins"));
+        new Integrations(qEnvironmentVariable(Environment::ENV_YIO_PLUGIN_DIR, appPath + "/plugins"),
+                         QFileInfo(cmdLineHandler.configFile()).path() + "/plugins.cbor");
     // Make integration state available in QML
     qmlRegisterUncreatableType<Integrations>("Integrations", 1, 0, "Integrations",
                                              "Not creatable, only used for enum.");
@@ -299,6 +303,12 @@ int main(int argc, char* argv[]) {
 
     softwareUpdate->start();
 
+    // GUI frame time statistics, reported by the get_api_stats API request
+    QQuickWindow* mainWindow = qobject_cast<QQuickWindow*>(engine.rootObjects().first());
+    if (mainWindow) {
+        new FrameTimeMonitor(mainWindow, mainWindow);
+    }
+
     QObject* mainApplicationWindow = config->getQMLObject("applicationWindow");
     touchEventFilter->setSource(mainApplicationWindow);
 
@@ -0,0 +1,135 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2020 Markus Zehnder <business@markuszehnder.ch>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+
+#include "networkdiscovery.h"
+
+#include <QLoggingCategory>
+#include <QtDebug>
+
+static Q_LOGGING_CATEGORY(CLASS_LC, "discovery");
+
+NetworkDiscovery::NetworkDiscovery(QObject *parent) : QObject(parent) {}
+
+NetworkDiscovery::~NetworkDiscovery() { stop(); }
+
+void NetworkDiscovery::browse(const QString &mdns) {
+    if (mdns.isEmpty() || m_browsers.contains(mdns)) {
+        return;
+    }
+
+    qCDebug(CLASS_LC) << "Starting mdns discovery" << mdns;
+
+    QZeroConf *browser = new QZeroConf(this);
+    connect(browser, &QZeroConf::serviceAdded, this,
+            [this, mdns](QZeroConfService item) { onServiceResolved(mdns, item); });
+    connect(browser, &QZeroConf::serviceUpdated, this,
+            [this, mdns](QZeroConfService item) { onServiceResolved(mdns, item); });
+    connect(browser, &QZeroConf::serviceRemoved, this,
+            [this, mdns](QZeroConfService item) { onServiceRemoved(mdns, item); });
+    connect(browser, &QZeroConf::error, this, [this, mdns, browser](QZeroConf::error_t error) {
+        // a failed browser is restarted with the next discovery request
+        qCWarning(CLASS_LC) << "Discovery failed" << mdns << error;
+        if (m_browsers.value(mdns) == browser) {
+            m_browsers.remove(mdns);
+            browser->deleteLater();
+        }
+    });
+
+    m_browsers.insert(mdns, browser);
+    browser->startBrowser(mdns);
+}
+
+void NetworkDiscovery::stop() {
+    for (QZeroConf *browser : qAsConst(m_browsers)) {
+        if (browser->browserExists()) {
+            browser->stopBrowser();
+        }
+        browser->deleteLater();
+    }
+    m_browsers.clear();
+    m_services.clear();
+}
+
+QVariantList NetworkDiscovery::services(const QString &mdns) const {
+    QVariantList list;
+    for (const QVariantMap &service : m_services) {
+        if (mdns.isEmpty() || service.value("mdns").toString() == mdns) {
+            list.append(service);
+        }
+    }
+    return list;
+}
+
+QVariantMap NetworkDiscovery::statistics() const {
+    QVariantMap stats;
+    stats.insert("browsers", QStringList(m_browsers.keys()));
+    stats.insert("services", m_services.size());
+    stats.insert("added", m_added);
+    stats.insert("updated", m_updated);
+    stats.insert("removed", m_removed);
+    stats.insert("duplicates", m_duplicates);
+    return stats;
+}
+
+void NetworkDiscovery::onServiceResolved(const QString &mdns, QZeroConfService item) {
+    QVariantMap txt;
+
+    QMap<QByteArray, QByteArray> txtInfo = item->txt();
+    for (auto i = txtInfo.cbegin(); i != txtInfo.cend(); ++i) {
+        txt.insert(i.key(), i.value());
+    }
+
+    QVariantMap service;
+    service.insert("name", item->name());
+    service.insert("mdns", mdns);
+    service.insert("host", item->host());
+    service.insert("ip", item->ip().toString());
+    service.insert("port", item->port());
+    service.insert("txt", txt);
+
+    QString key  = serviceKey(mdns, item->name());
+    auto    iter = m_services.find(key);
+    if (iter == m_services.end()) {
+        qCDebug(CLASS_LC) << "Zeroconf found" << item;
+        m_services.insert(key, service);
+        m_added++;
+        emit serviceAdded(service);
+    } else if (iter.value() != service) {
+        qCDebug(CLASS_LC) << "Zeroconf updated" << item;
+        iter.value() = service;
+        m_updated++;
+        emit serviceUpdated(service);
+    } else {
+        // resolved again, e.g. on another interface
+        m_duplicates++;
+    }
+}
+
+void NetworkDiscovery::onServiceRemoved(const QString &mdns, QZeroConfService item) {
+    QVariantMap service = m_services.take(serviceKey(mdns, item->name()));
+    if (!service.isEmpty()) {
+        qCDebug(CLASS_LC) << "Zeroconf removed" << item;
+        m_removed++;
+        emit serviceRemoved(service);
+    }
+}
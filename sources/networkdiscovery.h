@@ -0,0 +1,86 @@
+/******************************************************************************
+ *
+ * Copyright (C) 2020 Markus Zehnder <business@markuszehnder.ch>
+ *
+ * This file is part of the YIO-Remote software project.
+ *
+ * YIO-Remote software is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * YIO-Remote software is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with YIO-Remote software. If not, see <https://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ *****************************************************************************/
+
+
+#pragma once
+
+#include <QHash>
+#include <QObject>
+#include <QVariantMap>
+
+#include "../qtzeroconf/qzeroconf.h"
+
+/**
+ * @brief NetworkDiscovery keeps a cache of the mDNS services of all browsed service types.
+ * One long-lived browser runs per service type. Services are identified by service type and instance name: resolving
+ * the same instance again, e.g. on another network interface, only updates the cache if its data changed.
+ * Services are removed from the cache when the browser reports them gone: with a goodbye packet or when the record TTL
+ * expired in the mDNS cache.
+ * A service is a map with name, mdns (service type), host, ip, port and txt.
+ */
+class NetworkDiscovery : public QObject {
+    Q_OBJECT
+
+ public:
+    explicit NetworkDiscovery(QObject* parent = nullptr);
+    ~NetworkDiscovery() override;
+
+    /**
+     * @brief Starts browsing for the service type if not already running. The browser runs until stop is called.
+     */
+    void browse(const QString& mdns);
+    bool isBrowsing(const QString& mdns) const { return m_browsers.contains(mdns); }
+
+    /**
+     * @brief Stops all browsers and clears the cache.
+     */
+    void stop();
+
+    /**
+     * @brief Returns the cached services of the service type, or of all service types if empty.
+     */
+    QVariantList services(const QString& mdns = QString()) const;
+
+    /**
+     * @brief Returns the browsed service types, the number of cached services and the cache counters.
+     */
+    QVariantMap statistics() const;
+
+ signals:
+    void serviceAdded(const QVariantMap& service);
+    void serviceUpdated(const QVariantMap& service);
+    void serviceRemoved(const QVariantMap& service);
+
+ private:
+    void onServiceResolved(const QString& mdns, QZeroConfService item);
+    void onServiceRemoved(const QString& mdns, QZeroConfService item);
+
+    static QString serviceKey(const QString& mdns, const QString& name) { return mdns + '/' + name; }
+
+    QHash<QString, QZeroConf*>  m_browsers;  // service type -> browser
+    QHash<QString, QVariantMap> m_services;  // service type / instance name -> service
+
+    quint32 m_added      = 0;
+    quint32 m_updated    = 0;
+    quint32 m_removed    = 0;
+    quint32 m_duplicates = 0;
+};
@@ -48,7 +48,11 @@ void StandbyControl::init() {
     m_batteryFuelGauge->begin();
 }
 
-void StandbyControl::shutdown() { m_interruptHandler->shutdown(); }
+void StandbyControl::shutdown() {
+    // persist pending configuration changes before the power is cut
+    m_config->flush();
+    m_interruptHandler->shutdown();
+}
 
 StandbyControl::StandbyControl(DisplayControl *displayControl, ProximitySensor *proximitySensor,
                                LightSensor *lightSensor, TouchEventFilter *touchEventFilter,
@@ -147,7 +151,7 @@ void StandbyControl::wakeup() {
             for (int i = 0; i < m_integrations->list().length(); i++) {
                 IntegrationInterface *integrationObj =
                     qobject_cast<IntegrationInterface *>(m_integrations->list().at(i));
-                integrationObj->leaveStandby();
+                IntegrationThreads::post(integrationObj, [](IntegrationInterface *ii) { ii->leaveStandby(); });
             }
 
             // start bluetooth scanning
@@ -182,12 +186,8 @@ void StandbyControl::wakeup() {
             m_displayControl->setMode(DisplayControl::StandbyOff);
             readAmbientLight();
 
-            // connect integrations
-            for (int i = 0; i < m_integrations->list().length(); i++) {
-                IntegrationInterface *integrationObj =
-                    qobject_cast<IntegrationInterface *>(m_integrations->list().at(i));
-                integrationObj->connect();
-            }
+            // connect integrations when wifi is up, in priority order
+            m_integrations->reconnectScheduler()->connectAll();
 
             m_api->start();
 
@@ -323,7 +323,7 @@ void StandbyControl::onSecondsTimerTimeout() {
         // integrations set standby mode
         for (int i = 0; i < m_integrations->list().length(); i++) {
             IntegrationInterface *integrationObj = qobject_cast<IntegrationInterface *>(m_integrations->list().at(i));
-            integrationObj->enterStandby();
+            IntegrationThreads::post(integrationObj, [](IntegrationInterface *ii) { ii->enterStandby(); });
         }
 
         m_format.setSwapInterval(60);
@@ -344,9 +344,10 @@ void StandbyControl::onSecondsTimerTimeout() {
     if (m_elapsedTime == m_wifiOffTime && m_wifiOffTime != 0 && m_mode == STANDBY &&
         m_batteryFuelGauge->getAveragePower() <= 0) {
         // disconnect integrations
+        m_integrations->reconnectScheduler()->cancel();
         for (int i = 0; i < m_integrations->list().length(); i++) {
             IntegrationInterface *integrationObj = qobject_cast<IntegrationInterface *>(m_integrations->list().at(i));
-            integrationObj->disconnect();
+            IntegrationThreads::post(integrationObj, [](IntegrationInterface *ii) { ii->disconnect(); });
         }
 
         // turn off API
@@ -39,6 +39,7 @@ TranslationHandler::~TranslationHandler() { s_instance = nullptr; }
 
 void TranslationHandler::selectLanguage(QString language) {
     qCDebug(CLASS_LC) << "Language selected:" << language;
+    m_language = language;
 
     qGuiApp->removeTranslator(m_translator);
     m_translator->load(":/translations/" + language);
@@ -58,3 +59,14 @@ void TranslationHandler::selectLanguage(QString language) {
 
     emit languageChanged();
 }
+
+void TranslationHandler::installPluginTranslator(QObject *plugin) {
+    PluginInterface *pInterface = qobject_cast<PluginInterface *>(plugin);
+    if (!pInterface || m_language.isEmpty()) {
+        return;
+    }
+    qGuiApp->installTranslator(pInterface->installTranslator(m_language));
+    qCDebug(CLASS_LC) << "Installed translation for plugin" << m_language << pInterface;
+
+    emit languageChanged();
+}
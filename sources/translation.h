@@ -41,6 +41,9 @@ class TranslationHandler : public QObject {
     QString          getEmptyString() { return ""; }
     Q_INVOKABLE void selectLanguage(QString language);
 
+    // install the translation of the selected language for a plugin loaded after selectLanguage
+    void installPluginTranslator(QObject *plugin);
+
     static TranslationHandler *getInstance() { return s_instance; }
 
  signals:
@@ -51,4 +54,5 @@ class TranslationHandler : public QObject {
 
     QTranslator *m_translator;
     QQmlEngine * m_engine;
+    QString      m_language;
 };
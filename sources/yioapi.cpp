@@ -26,10 +26,15 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QLoggingCategory>
+#include <QElapsedTimer>
 #include <QNetworkInterface>
-#include <QTimer>
+#include <QSet>
+#include <QSharedPointer>
 #include <QtDebug>
 
+#include "configutil.h"
+#include "frametimemonitor.h"
+#include "jsonpatch.h"
 #include "launcher.h"
 #include "standbycontrol.h"
 #include "translation.h"
@@ -38,23 +43,69 @@ static Q_LOGGING_CATEGORY(CLASS_LC, "api");
 
 YioAPI *YioAPI::s_instance = nullptr;
 
+// default and maximum coalescing window of entity attribute changes in milliseconds
+static const int ENTITY_COALESCING_INTERVAL     = 50;
+static const int ENTITY_COALESCING_INTERVAL_MAX = 10000;
+
+// maximum number of requests in a batch
+static const int BATCH_MAX_REQUESTS = 1000;
+
+// default and maximum number of entities per get_entity_states page
+static const int ENTITY_STATES_LIMIT     = 100;
+static const int ENTITY_STATES_LIMIT_MAX = 500;
+
+// entity commands waiting longer than the longest command queue TTL have expired, in microseconds
+static const qint64 ENTITY_COMMAND_MAX_WAIT = 10000000;
+
 YioAPI::YioAPI(QQmlApplicationEngine *engine) : m_engine(engine) {
     s_instance     = this;
     m_entities     = Entities::getInstance();
     m_integrations = Integrations::getInstance();
     m_config       = Config::getInstance();
+    m_discovery    = new NetworkDiscovery(this);
+    m_events       = new ApiEventHub(m_config, m_entities, m_discovery, this);
+    m_clock.start();
+
+    auto discovered = [this](const QVariantMap &service) {
+        QVariantMap discoveredServices;
+        discoveredServices.insert(service.value("name").toString(), service);
+        emit serviceDiscovered(discoveredServices);
+    };
+    connect(m_discovery, &NetworkDiscovery::serviceAdded, this, discovered);
+    connect(m_discovery, &NetworkDiscovery::serviceUpdated, this, discovered);
+
+    // networking and request decoding run in the server thread, requests are dispatched in the GUI thread
+    m_server = new ApiServer(m_clock);
+    m_server->moveToThread(&m_serverThread);
+    connect(&m_serverThread, &QThread::finished, m_server, &QObject::deleteLater);
+    connect(m_server, &ApiServer::clientConnected, this, &YioAPI::onClientConnected);
+    connect(m_server, &ApiServer::clientDisconnected, this, &YioAPI::onClientDisconnected);
+    connect(m_server, &ApiServer::requestReceived, this, &YioAPI::onRequestReceived);
+    connect(m_integrations, &Integrations::commandHandedOver, this, &YioAPI::onEntityCommandHandedOver);
+    connect(m_config, &Config::settingsChanged, this,
+            [this]() { m_server->setLimits(ApiClient::limitsFromSettings(m_config->getSettings())); });
+
+    m_serverThread.setObjectName("ApiServer");
+    m_serverThread.start();
 }
 
-YioAPI::~YioAPI() { s_instance = nullptr; }
+YioAPI::~YioAPI() {
+    s_instance = nullptr;
+    if (m_running) {
+        stop();
+    }
+    m_serverThread.quit();
+    m_serverThread.wait(3000);
+}
 
 void YioAPI::start() {
-    m_server = new QWebSocketServer(QStringLiteral("YIO API"), QWebSocketServer::NonSecureMode, this);
+    m_server->setLimits(ApiClient::limitsFromSettings(m_config->getSettings()));
 
     // start websocket server on port 946(YIO)
-    if (m_server->listen(QHostAddress::Any, 946)) {
-        connect(m_server, &QWebSocketServer::newConnection, this, &YioAPI::onNewConnection);
-        connect(m_server, &QWebSocketServer::closed, this, &YioAPI::onClosed);
-
+    bool listening = false;
+    QMetaObject::invokeMethod(m_server, "listen", Qt::BlockingQueuedConnection, Q_RETURN_ARG(bool, listening),
+                              Q_ARG(quint16, 946));
+    if (listening) {
         m_running = true;
         emit runningChanged();
     }
@@ -79,7 +130,11 @@ void YioAPI::start() {
 }
 
 void YioAPI::stop() {
-    m_server->close();
+    QMetaObject::invokeMethod(m_server, "close", Qt::BlockingQueuedConnection);
+    for (ApiClient *apiClient : qAsConst(m_clients)) {
+        m_events->removeClient(apiClient);
+        apiClient->deleteLater();
+    }
     m_clients.clear();
     m_running = false;
     m_zeroConf.stopServicePublish();
@@ -87,11 +142,31 @@ void YioAPI::stop() {
 }
 
 void YioAPI::sendMessage(QString message) {
-    QMap<QWebSocket *, bool>::iterator i;
-    for (i = m_clients.begin(); i != m_clients.end(); i++) {
-        if (i.value()) {
-            QWebSocket *socket = i.key();
-            socket->sendTextMessage(message);
+    // CBOR clients only receive binary frames: encode the message once, and only if such a client is connected
+    QByteArray cbor;
+    bool       parsed = false;
+
+    for (ApiClient *client : qAsConst(m_clients)) {
+        if (!client->isAuthenticated()) {
+            continue;
+        }
+        if (client->encoding() != ApiClient::Encoding::Cbor) {
+            client->sendEvent(message);
+            continue;
+        }
+        if (!parsed) {
+            parsed = true;
+            QJsonParseError error;
+            QJsonDocument   doc = QJsonDocument::fromJson(message.toUtf8(), &error);
+            if (error.error != QJsonParseError::NoError || !doc.isObject()) {
+                qCWarning(CLASS_LC) << "Not sending message to CBOR clients, it is no JSON object:"
+                                    << error.errorString();
+            } else {
+                cbor = ApiClient::toCbor(doc.object().toVariantMap());
+            }
+        }
+        if (!cbor.isEmpty()) {
+            client->sendEvent(cbor);
         }
     }
 }
@@ -99,182 +174,281 @@ void YioAPI::sendMessage(QString message) {
 QVariantMap YioAPI::getConfig() { return m_config->getConfig(); }
 
 bool YioAPI::setConfig(QVariantMap config) {
+    // validates and writes the configuration
     m_config->setConfig(config);
-    if (!m_config->isValid()) {
-        return false;
-    }
+    return m_config->isValid();
+}
 
-    return m_config->writeConfig();
+bool YioAPI::setConfig(const QVariantMap &config, const QStringList &changedPaths) {
+    return m_config->setConfig(config, changedPaths);
 }
 
-bool YioAPI::addEntity(QVariantMap entity) {
-    // get the type of the new entity
-    QString entityType = entity.value("type").toString();
-    qCDebug(CLASS_LC) << "Adding entity type:" << entityType;
+bool YioAPI::addEntity(QVariantMap entity) { return addEntities({entity}); }
 
-    // remove the key that is not needed
-    entity.remove("type");
+bool YioAPI::updatEntity(QVariantMap entity) {
+    qCDebug(CLASS_LC) << "Update entity:" << entity.value("entity_id").toString();
+    return updateEntities({entity});
+}
+
+bool YioAPI::removeEntity(QString entityId) { return removeEntities({entityId}); }
+
+static bool setError(QString *error, const QString &message) {
+    qCWarning(CLASS_LC) << message;
+    if (error) {
+        *error = message;
+    }
+    return false;
+}
 
+bool YioAPI::checkEntityConfig(const QString &entityType, const QVariantMap &entity, QString *error) {
     // check if the type is supported
     if (!m_entities->supportedEntities().contains(entityType)) {
-        return false;
+        return setError(error, QString("Entity type is not supported: %1").arg(entityType));
     }
 
-    qCDebug(CLASS_LC) << "Entity type is supported";
-
     // check the input if it's OK
     if (!entity.contains(Config::KEY_AREA) && !entity.contains(Config::KEY_ENTITY_ID) &&
         !entity.contains(Config::KEY_FRIENDLYNAME) && !entity.contains(Config::KEY_INTEGRATION) &&
         !entity.contains(Config::KEY_SUPPORTED_FEATURES) && !entity.contains(Config::KEY_TYPE)) {
-        return false;
+        return setError(error, "Invalid entity configuration");
     }
 
-    qCDebug(CLASS_LC) << "Input data is OK.";
+    if (!m_integrations->get(entity.value(Config::KEY_INTEGRATION).toString())) {
+        return setError(error, QString("Integration is not loaded: %1").arg(entity.value(Config::KEY_INTEGRATION)
+                                                                               .toString()));
+    }
 
-    // check if entity alread loaded. If so, it exist in config.json and the database
-    QObject *eObj = m_entities->get(entity.value("entity_id").toString());
+    return true;
+}
 
-    qCDebug(CLASS_LC) << "Entity object:" << eObj;
-    if (eObj) {
-        qCDebug(CLASS_LC) << "Entity is loaded.";
-        return false;
-    }
+bool YioAPI::addEntities(const QVariantList &entityList, QString *error) {
+    QMap<QString, QVariantList> newEntities;  // entity type -> entity configurations
+    QSet<QString>               entityIds;
 
-    qCDebug(CLASS_LC) << "Entity is not loaded.";
+    for (const QVariant &item : entityList) {
+        QVariantMap entity = item.toMap();
+        // get the type of the new entity
+        QString entityType = entity.value("type").toString();
+        QString entityId   = entity.value(Config::KEY_ENTITY_ID).toString();
+        qCDebug(CLASS_LC) << "Adding entity:" << entityId << "type:" << entityType;
 
-    // get the config
-    QVariantMap  c            = getConfig();
-    QVariantMap  entities     = c.value("entities").toMap();
-    QVariantList entitiesType = entities.value(entityType).toList();
+        // remove the key that is not needed
+        entity.remove("type");
+
+        if (!checkEntityConfig(entityType, entity, error)) {
+            return false;
+        }
+
+        // check if entity alread loaded. If so, it exist in config.json and the database
+        if (m_entities->get(entityId) || entityIds.contains(entityId)) {
+            return setError(error, QString("Entity already exists: %1").arg(entityId));
+        }
 
-    // add the entity to the lsit
-    entitiesType.append(entity);
+        entityIds.insert(entityId);
+        newEntities[entityType].append(entity);
+    }
 
-    // put entities back to config
-    entities.insert(entityType, entitiesType);
+    // add the entities to the config
+    QVariantMap c        = getConfig();
+    QVariantMap entities = c.value("entities").toMap();
+    QStringList changedPaths;
+    for (auto it = newEntities.cbegin(); it != newEntities.cend(); ++it) {
+        entities.insert(it.key(), entities.value(it.key()).toList() + it.value());
+        changedPaths.append(ConfigUtil::jsonPointer({"entities", it.key()}));
+    }
     c.insert("entities", entities);
 
-    // write the config back
-    bool success = setConfig(c);
+    // write the config back once
+    if (!setConfig(c, changedPaths)) {
+        return setError(error, m_config->getError());
+    }
 
-    delete eObj;
+    // load the entities to the database once the configuration is committed
+    m_config->afterCommit([this, newEntities]() {
+        for (auto it = newEntities.cbegin(); it != newEntities.cend(); ++it) {
+            for (const QVariant &item : it.value()) {
+                QVariantMap entity      = item.toMap();
+                QObject *   obj         = m_integrations->get(entity.value(Config::KEY_INTEGRATION).toString());
+                auto        integration = qobject_cast<IntegrationInterface *>(obj);
 
-    // if the config write is successful, load the entity to the database
-    if (success) {
-        // get the integration object
-        QObject *obj = m_integrations->get(entity.value("integration").toString());
-        if (obj) {
-            IntegrationInterface *integration = qobject_cast<IntegrationInterface *>(obj);
+                // add it to the entity registry
+                m_entities->add(it.key(), entity, integration);
+            }
+        }
+    });
 
-            // add it to the entity registry
-            m_entities->add(entityType, entity, integration);
+    qCDebug(CLASS_LC) << "Added entities:" << entityIds.size();
+    return true;
+}
 
-            qCDebug(CLASS_LC) << "Add entity success: true";
+bool YioAPI::updateEntities(const QVariantList &entityList, QString *error) {
+    QList<QPair<QString, QVariantMap>> updates;  // entity type, entity configuration
+    QVariantMap                        c        = getConfig();
+    QVariantMap                        entities = c.value("entities").toMap();
+    QStringList                        changedPaths;
 
-            return true;
-        } else {
-            qCDebug(CLASS_LC) << "Add entity success: false";
+    for (const QVariant &item : entityList) {
+        QVariantMap entity     = item.toMap();
+        QString     entityType = entity.value("type").toString();
+        QString     entityId   = entity.value(Config::KEY_ENTITY_ID).toString();
+
+        // remove the key that is not needed
+        entity.remove("type");
+
+        Entity *obj = qobject_cast<Entity *>(m_entities->get(entityId));
+        if (!obj) {
+            return setError(error, QString("Entity doesn't exist: %1").arg(entityId));
+        }
+        if (!checkEntityConfig(entityType, entity, error)) {
             return false;
         }
-    } else {
-        qCDebug(CLASS_LC) << "Add entity success: false";
-        return false;
+
+        // replace the entity configuration, move it to the new type list if the type changed
+        QString      oldType     = obj->type();
+        QVariantList oldEntities = entities.value(oldType).toList();
+        int          index       = -1;
+        for (int i = 0; i < oldEntities.length(); i++) {
+            if (oldEntities[i].toMap().value(Config::KEY_ENTITY_ID).toString() == entityId) {
+                index = i;
+                break;
+            }
+        }
+
+        if (oldType == entityType && index >= 0) {
+            oldEntities[index] = entity;
+            entities.insert(oldType, oldEntities);
+        } else {
+            if (index >= 0) {
+                oldEntities.removeAt(index);
+                entities.insert(oldType, oldEntities);
+            }
+            entities.insert(entityType, entities.value(entityType).toList() << entity);
+        }
+
+        for (const QString &type : {oldType, entityType}) {
+            QString path = ConfigUtil::jsonPointer({"entities", type});
+            if (!changedPaths.contains(path)) {
+                changedPaths.append(path);
+            }
+        }
+        updates.append(qMakePair(entityType, entity));
     }
-}
 
-bool YioAPI::updatEntity(QVariantMap entity) {
-    qCDebug(CLASS_LC) << "Update entity:" << entity.value("entity_id").toString();
+    c.insert("entities", entities);
 
-    // remove entity
-    if (!removeEntity(entity.value("entity_id").toString())) {
-        return false;
+    // write the config back once
+    if (!setConfig(c, changedPaths)) {
+        return setError(error, m_config->getError());
     }
 
-    // add new entity
-    return addEntity(entity);
-}
+    // update the entities in place: existing QML bindings stay alive. Only recreate them if not possible.
+    m_config->afterCommit([this, updates]() {
+        for (const auto &update : updates) {
+            QString entityId = update.second.value(Config::KEY_ENTITY_ID).toString();
+            Entity *obj      = qobject_cast<Entity *>(m_entities->get(entityId));
+            if (obj && obj->type() == update.first && obj->updateConfig(update.second)) {
+                continue;
+            }
 
-bool YioAPI::removeEntity(QString entityId) {
-    qCDebug(CLASS_LC) << "Removing entity:" << entityId;
+            qCDebug(CLASS_LC) << "Recreating entity:" << entityId;
+            m_entities->removeMediaplayersPlaying(entityId, true);
+            m_entities->remove(entityId);
+            if (obj) {
+                obj->deleteLater();
+            }
+            QObject *integration = m_integrations->get(update.second.value(Config::KEY_INTEGRATION).toString());
+            m_entities->add(update.first, update.second, qobject_cast<IntegrationInterface *>(integration));
+        }
+    });
 
-    QObject *        o = m_entities->get(entityId);
-    EntityInterface *eIface;
-    if (o) {
-        eIface = qobject_cast<EntityInterface *>(o);
-        if (!eIface) {
-            qCDebug(CLASS_LC) << "Entity doesn't exist, probably already removed:" << entityId;
-            return false;
+    return true;
+}
+
+bool YioAPI::removeEntities(const QStringList &entityIds, QString *error) {
+    QSet<QString> ids;
+    QSet<QString> types;
+    for (const QString &entityId : entityIds) {
+        qCDebug(CLASS_LC) << "Removing entity:" << entityId;
+        Entity *obj = qobject_cast<Entity *>(m_entities->get(entityId));
+        if (!obj) {
+            return setError(error, QString("Entity doesn't exist, probably already removed: %1").arg(entityId));
         }
+        ids.insert(entityId);
+        types.insert(obj->type());
     }
 
-    // remove entity from groups
+    // groups, favorites and entities are validated and written at once
+    m_config->beginTransaction();
+
+    // remove entities from groups
     QVariantMap groups = m_config->getGroups();
-    for (QVariantMap::const_iterator iter = groups.cbegin(); iter != groups.cend(); ++iter) {
+    for (QVariantMap::iterator iter = groups.begin(); iter != groups.end(); ++iter) {
         QVariantMap  item          = iter.value().toMap();
         QVariantList groupEntities = item.value("entities").toList();
-        for (int i = 0; i < groupEntities.length(); i++) {
-            if (groupEntities[i].toString() == entityId) {
+        for (int i = groupEntities.length() - 1; i >= 0; i--) {
+            if (ids.contains(groupEntities[i].toString())) {
                 groupEntities.removeAt(i);
-                break;
             }
         }
         item.insert("entities", groupEntities);
-        groups.insert(iter.key(), item);
+        iter.value() = item;
     }
     m_config->setGroups(groups);
 
-    // remove entity from favorites
+    // remove entities from favorites
     QVariantMap profiles = m_config->getProfiles();
-    for (QVariantMap::const_iterator iter = profiles.cbegin(); iter != profiles.cend(); ++iter) {
-        QVariantMap  item            = iter.value().toMap();
-        QVariantList profileEntities = item.value("favorites").toList();
-        for (int i = 0; i < profileEntities.length(); i++) {
-            if (profileEntities[i].toString() == entityId) {
-                profileEntities.removeAt(i);
-                break;
+    for (QVariantMap::iterator iter = profiles.begin(); iter != profiles.end(); ++iter) {
+        QVariantMap  item             = iter.value().toMap();
+        QVariantList profileFavorites = item.value("favorites").toList();
+        for (int i = profileFavorites.length() - 1; i >= 0; i--) {
+            if (ids.contains(profileFavorites[i].toString())) {
+                profileFavorites.removeAt(i);
             }
         }
-        item.insert("favorites", profileEntities);
-        profiles.insert(iter.key(), item);
+        item.insert("favorites", profileFavorites);
+        iter.value() = item;
     }
-
-    //    m_config->setProfiles(profiles);
+    m_config->setProfiles(profiles);
 
     // remove from config
-    // get the config
-    eIface                    = qobject_cast<EntityInterface *>(o);
-    QVariantMap  c            = getConfig();
-    QVariantMap  entities     = c.value("entities").toMap();
-    QVariantList entitiesType = entities.value(eIface->type()).toList();
-
-    for (int i = 0; i < entitiesType.length(); i++) {
-        if (entitiesType[i].toMap().value("entity_id").toString() == entityId) {
-            entitiesType.removeAt(i);
-            break;
+    QVariantMap c        = getConfig();
+    QVariantMap entities = c.value("entities").toMap();
+    QStringList changedPaths;
+    for (const QString &type : types) {
+        QVariantList entitiesType = entities.value(type).toList();
+        for (int i = entitiesType.length() - 1; i >= 0; i--) {
+            if (ids.contains(entitiesType[i].toMap().value(Config::KEY_ENTITY_ID).toString())) {
+                entitiesType.removeAt(i);
+            }
         }
+        entities.insert(type, entitiesType);
+        changedPaths.append(ConfigUtil::jsonPointer({"entities", type}));
     }
-
-    // put entities back to config
-    entities.insert(eIface->type(), entitiesType);
     c.insert("entities", entities);
 
-    delete eIface;
-
     // write the config back
-    bool success = setConfig(c);
-    if (success) {
-        // if it is a media player and playing, remove from mini media player
-        m_entities->removeMediaplayersPlaying(entityId, true);
+    setConfig(c, changedPaths);
+    if (!m_config->commitTransaction()) {
+        return setError(error, QString("Removing entities failed: %1").arg(m_config->getError()));
+    }
+
+    // within an enclosing transaction the entities are kept until it is committed
+    m_config->afterCommit([this, entityIds]() {
+        for (const QString &entityId : entityIds) {
+            // if it is a media player and playing, remove from mini media player
+            m_entities->removeMediaplayersPlaying(entityId, true);
+
+            // remove from database
+            QObject *obj = m_entities->get(entityId);
+            m_entities->remove(entityId);
+            if (obj) {
+                obj->deleteLater();
+            }
+        }
+    });
 
-        // remove from database
-        m_entities->remove(entityId);
-        m_config->setProfiles(profiles);
-        qCDebug(CLASS_LC) << "Removing entity success:" << entityId;
-        return true;
-    } else {
-        qCDebug(CLASS_LC) << "Removing entity failure:" << entityId;
-        return false;
-    }
+    qCDebug(CLASS_LC) << "Removed entities:" << entityIds.size();
+    return true;
 }
 
 bool YioAPI::addIntegration(QVariantMap integration) {
@@ -302,20 +476,16 @@ bool YioAPI::addIntegration(QVariantMap integration) {
 
     qCDebug(CLASS_LC) << "Input data is OK.";
 
-    // check if the integration already exists
-    QObject *iObj = m_integrations->get(integrationId);
-    if (iObj) {
-        IntegrationInterface *ii = qobject_cast<IntegrationInterface *>(iObj);
-        if (ii) {
-            if (ii->integrationId() == integrationId) {
-                return false;
-            }
-        } else {
-            return false;
-        }
+    // check if the integration already exists: the instances are registered by their id, the integration object
+    // isn't asked from the GUI thread
+    if (m_integrations->get(integrationId)) {
+        return false;
     }
 
-    delete iObj;
+    // the configuration is only changed if the instance can be created
+    if (!m_integrations->canCreateIntegration(integrationType)) {
+        return false;
+    }
 
     // get the config
     QVariantMap  c                = getConfig();
@@ -334,12 +504,11 @@ bool YioAPI::addIntegration(QVariantMap integration) {
     c.insert("integrations", integrations);
 
     // write the config back
-    bool success = setConfig(c);
+    bool success = setConfig(c, {ConfigUtil::jsonPointer({"integrations", integrationType})});
 
     if (success) {
-        // load the integrations
-        m_integrations->load();
-        return true;
+        // only the new instance is created, the other integrations keep running
+        return m_integrations->createIntegration(integrationType, integration);
     } else {
         return false;
     }
@@ -369,6 +538,11 @@ bool YioAPI::updateIntegration(QVariantMap integration) {
         return false;
     }
 
+    // the configuration is only changed if the instance can be re-created with it
+    if (!m_integrations->canCreateIntegration(integrationType)) {
+        return false;
+    }
+
     // delete iObj;
 
     // get the config
@@ -377,14 +551,15 @@ bool YioAPI::updateIntegration(QVariantMap integration) {
     QVariantMap  integrationsType = integrations.value(integrationType).toMap();
     QVariantList integrationsData = integrationsType.value("data").toList();
 
-    bool success = false;
+    bool        success = false;
+    QVariantMap updated;
 
     for (int i = 0; i < integrationsData.length(); i++) {
         if (integrationsData[i].toMap().value("id").toString() == integration.value("id").toString()) {
-            QVariantMap ii = integrationsData[i].toMap();
-            ii.insert("friendly_name", integration.value("friendly_name").toString());
-            ii.insert("data", integration.value("data").toMap());
-            integrationsData[i] = ii;
+            updated = integrationsData[i].toMap();
+            updated.insert("friendly_name", integration.value("friendly_name").toString());
+            updated.insert("data", integration.value("data").toMap());
+            integrationsData[i] = updated;
             success             = true;
         }
     }
@@ -399,31 +574,40 @@ bool YioAPI::updateIntegration(QVariantMap integration) {
     c.insert("integrations", integrations);
 
     // write the config back
-    return setConfig(c);
+    if (!setConfig(c, {ConfigUtil::jsonPointer({"integrations", integrationType})})) {
+        return false;
+    }
+
+    // re-create only this instance, its entities are rebound
+    return m_integrations->updateIntegration(integrationType, updated);
 }
 
 bool YioAPI::removeIntegration(QString integrationId) {
     QObject *integration     = m_integrations->get(integrationId);
     QString  integrationType = m_integrations->getType(integrationId);
 
+    if (!integration) {
+        return false;
+    }
+
+    // all entities and the integration are removed from the configuration with one validation and write
+    m_config->beginTransaction();
+
     // unload all entities connected to the integration
+    QStringList              entityIds;
     QList<EntityInterface *> entities = m_entities->getByIntegration(integrationId);
     for (int i = 0; i < entities.length(); i++) {
-        // remove entity from config and database
-        if (entities[i]->integration() == integrationId) {
-            if (!removeEntity(entities[i]->entity_id())) {
-                return false;
-            }
-        }
+        entityIds.append(entities[i]->entity_id());
     }
-
-    // remove integration from database
-    if (integration) {
-        m_integrations->remove(integrationId);
-    } else {
+    // remove entities from config and database
+    if (!entityIds.isEmpty() && !removeEntities(entityIds)) {
+        m_config->rollbackTransaction();
         return false;
     }
 
+    // remove integration from database, after the entities and only if the configuration could be written
+    m_config->afterCommit([this, integrationId]() { m_integrations->remove(integrationId); });
+
     // remove integration from config file
     QVariantMap  config                     = getConfig();
     QVariantMap  configIntegrations         = config.value("integrations").toMap();
@@ -445,302 +629,242 @@ bool YioAPI::removeIntegration(QString integrationId) {
     config.insert("integrations", configIntegrations);
 
     // write the config back
-    return setConfig(config);
+    setConfig(config, {ConfigUtil::jsonPointer({"integrations", integrationType})});
+    return m_config->commitTransaction();
 }
 
 void YioAPI::discoverNetworkServices() {
-    // FIXME this is not multi threading safe!
-    // m_discoveredServices gets cleared if one of the discoverNetworkServices is called.
-    // At the moment this works since we only have the dock integration using this functionality.
-    // As soon as we have another integration plugin this can fail unpredictably since most integration plugins are
-    // running in their own thread. I.e. during startup and service discovery these methods will be called in parallel!
-    // Possible solution: use an identifier for discoverNetworkServices(), discoverNetworkServices(mdns) and
-    // discoveredServices(), e.g. the mdns name itself: map with mdns -> QZeroConf
-    // Possible solution 2: use a worker thread with signal / slot queuing
-
     // retrieve all supported mdns records from the integration plugins
-    m_discoverableServices = Integrations::getInstance()->getMDNSList();
-
-    for (int i = 0; i < m_discoverableServices.length(); i++) {
-        if (m_discoverableServices[i] != "") {
-            qCDebug(CLASS_LC) << "Starting mdns discovery" << m_discoverableServices[i];
-            discoverNetworkServices(m_discoverableServices[i]);
+    const QStringList discoverableServices = Integrations::getInstance()->getMDNSList();
+    for (const QString &mdns : discoverableServices) {
+        if (!mdns.isEmpty()) {
+            discoverNetworkServices(mdns);
         }
     }
 }
 
 void YioAPI::discoverNetworkServices(QString mdns) {
-    QZeroConf *zeroConfBrowser = new QZeroConf(this);
-    QObject *  context         = new QObject();
-    m_prevIp                   = "";
-
-    connect(zeroConfBrowser, &QZeroConf::serviceAdded, context, [=](QZeroConfService item) {
-        QVariantMap txt;
-
-        QMap<QByteArray, QByteArray> txtInfo = item->txt();
-
-        QMap<QByteArray, QByteArray>::iterator i;
-        for (i = txtInfo.begin(); i != txtInfo.end(); ++i) {
-            txt.insert(i.key(), i.value());
-        }
-
-        if (m_prevIp != item->ip().toString()) {
-            qCDebug(CLASS_LC) << "Zeroconf found" << item;
-
-            m_prevIp = item->ip().toString();
-
-            QVariantMap map;
-            map.insert(QString("name"), item->name());
-            map.insert(QString("ip"), m_prevIp);
-            map.insert(QString("port"), item->port());
-            map.insert(QString("mdns"), mdns);
-            map.insert(QString("txt"), txt);
+    // Integration plugins may call from their own thread: the browsers and the cache live in the GUI thread.
+    QMetaObject::invokeMethod(this, [this, mdns]() {
+        m_discovery->browse(mdns);
 
+        // answered from the cache, later changes are emitted as they arrive
+        for (const QVariant &service : m_discovery->services(mdns)) {
             QVariantMap discoveredServices;
-            discoveredServices.insert(item->name(), map);
-
+            discoveredServices.insert(service.toMap().value("name").toString(), service);
             emit serviceDiscovered(discoveredServices);
         }
     });
+}
 
-    connect(zeroConfBrowser, &QZeroConf::serviceUpdated, context, [=](QZeroConfService item) {
-        QVariantMap txt;
-
-        QMap<QByteArray, QByteArray> txtInfo = item->txt();
-
-        QMap<QByteArray, QByteArray>::iterator i;
-        for (i = txtInfo.begin(); i != txtInfo.end(); ++i) {
-            txt.insert(i.key(), i.value());
-        }
+void YioAPI::onClientConnected(QWebSocket *client, ApiClient *apiClient) {
+    qCDebug(CLASS_LC) << "Client connected" << client;
+    m_clients.insert(client, apiClient);
+}
 
-        if (m_prevIp != item->ip().toString()) {
-            qCDebug(CLASS_LC) << "Zeroconf updated" << item;
+const QHash<QString, YioAPI::ApiCommand> &YioAPI::apiCommands() {
+    static const QHash<QString, ApiCommand> commands = {
+        /// Authentication
+        {"auth",
+         {AuthLevel::Unauthenticated,
+          [](YioAPI *api, QWebSocket *client, int, const QVariantMap &map) { api->apiAuth(client, map); }}},
+        /// Button simulation through the api
+        {"button",
+         {AuthLevel::Authenticated,
+          [](YioAPI *api, QWebSocket *, int id, const QVariantMap &map) { api->apiSystemButton(id, map); }}},
+        /// Reboot
+        {"reboot", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiSystemReboot>}},
+        /// Shutdown
+        {"shutdown", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiSystemShutdown>}},
+        /// Subscribe to events
+        {"subscribe_events", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiSystemSubscribeToEvents>}},
+        /// Unsubscribe from events
+        {"unsubscribe_events", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiSystemUnsubscribeFromEvents>}},
+        /// Subscribe to entity attribute changes
+        {"subscribe_entities", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiSubscribeEntities>}},
+        /// Unsubscribe from entity attribute changes
+        {"unsubscribe_entities", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiUnsubscribeEntities>}},
+        /// Execute multiple requests
+        {"batch", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiBatch>}},
+        /// Request counters and latencies
+        {"get_api_stats", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiGetStats>}},
+        /// Get config
+        {"get_config", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiGetConfig>}},
+        /// Set config
+        {"set_config", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiSetConfig>}},
+        /// Patch config
+        {"patch_config", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiPatchConfig>}},
+        /// Discover integrations
+        {"discover_integrations", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiIntegrationsDiscover>}},
+        /// Get supported integrations
+        {"get_supported_integrations",
+         {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiIntegrationsGetSupported>}},
+        /// Get loaded integrations
+        {"get_loaded_integrations", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiIntegrationsGetLoaded>}},
+        /// Get data required to setup an integration
+        {"get_integration_setup_data", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiIntegrationGetData>}},
+        /// Add a new integration
+        {"add_integration", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiIntegrationAdd>}},
+        /// Update an integration
+        {"update_integration", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiIntegrationUpdate>}},
+        /// Remove an integration
+        {"remove_integration", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiIntegrationRemove>}},
+        /// Get supported entities
+        {"get_supported_entities", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiEntitiesGetSupported>}},
+        /// Get loaded entities
+        {"get_loaded_entities", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiEntitiesGetLoaded>}},
+        /// Get available entities from integrations
+        {"get_available_entities", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiEntitiesGetAvailable>}},
+        /// Add an entity
+        {"add_entity", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiEntitiesAdd>}},
+        /// Update an entity
+        {"update_entity", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiEntitiesUpdate>}},
+        /// Remove an entity
+        {"remove_entity", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiEntitiesRemove>}},
+        /// Send a command to an entity
+        {"entity_command", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiEntityCommand>}},
+        /// Get the current state of all or filtered entities, paginated
+        {"get_entity_states", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiEntityStates>}},
+        /// Add multiple entities
+        {"add_entities", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiEntitiesAddBulk>}},
+        /// Update multiple entities
+        {"update_entities", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiEntitiesUpdateBulk>}},
+        /// Remove multiple entities
+        {"remove_entities", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiEntitiesRemoveBulk>}},
+        /// Get all profiles
+        {"get_all_profiles", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiProfilesGetAll>}},
+        /// Set current profile
+        {"set_profile", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiProfilesSet>}},
+        /// Add new profile
+        {"add_profile", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiProfilesAdd>}},
+        /// Update a profile
+        {"update_profile", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiProfilesUpdate>}},
+        /// Remove a profile
+        {"remove_profile", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiProfilesRemove>}},
+        /// Get all pages
+        {"get_all_pages", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiPagesGetAll>}},
+        /// Add a page
+        {"add_page", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiPagesAdd>}},
+        /// Update a page
+        {"update_page", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiPagesUpdate>}},
+        /// Remove a page
+        {"remove_page", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiPagesRemove>}},
+        /// Get all groups
+        {"get_all_groups", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiGroupsGetAll>}},
+        /// Add a group
+        {"add_group", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiGroupsAdd>}},
+        /// Update a group
+        {"update_group", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiGroupsUpdate>}},
+        /// Remove a group
+        {"remove_group", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiGroupsRemove>}},
+        /// Get all languages
+        {"get_languages", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiSettingsGetAllLanguages>}},
+        /// Set a languages
+        {"set_language", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiSettingsSetLanguage>}},
+        /// Set auto brightness
+        {"set_auto_brightness", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiSettingsSetAutoBrightness>}},
+        /// Set dark mode
+        {"set_dark_mode", {AuthLevel::Authenticated, &YioAPI::apiCall<&YioAPI::apiSettingsSetDarkMode>}}
+    };
+    return commands;
+}
 
-            m_prevIp = item->ip().toString();
+void YioAPI::onRequestReceived(QWebSocket *client, const QVariant &request, qint64 received) {
+    auto clientIter = m_clients.constFind(client);
+    if (clientIter == m_clients.constEnd()) {
+        return;
+    }
 
-            QVariantMap map;
-            map.insert(QString("name"), item->name());
-            map.insert(QString("ip"), m_prevIp);
-            map.insert(QString("port"), item->port());
-            map.insert(QString("mdns"), mdns);
-            map.insert(QString("txt"), txt);
+    // time the request waited for the GUI thread, e.g. while QML pages are loaded
+    m_requestReceived = received;
+    m_dispatchDelay.record((m_clock.nsecsElapsed() - received) / 1000);
 
-            QVariantMap discoveredServices;
-            discoveredServices.insert(item->name(), map);
+    processRequest(clientIter.value(), client, request);
+}
 
-            emit serviceDiscovered(discoveredServices);
-        }
-    });
+void YioAPI::onEntityCommandHandedOver(const QString &entityType, const QString &entityId, int command) {
+    auto iter = m_pendingEntityCommands.find(qMakePair(entityId, command));
+    if (iter == m_pendingEntityCommands.end()) {
+        // not sent by the API
+        return;
+    }
+    qint64 latency = (m_clock.nsecsElapsed() - iter.value()) / 1000;
+    m_pendingEntityCommands.erase(iter);
 
-    if (!zeroConfBrowser->browserExists()) {
-        zeroConfBrowser->startBrowser(mdns);
-        QTimer::singleShot(10000, [=]() {
-            qCDebug(CLASS_LC) << "Stopping mdns discovery after 10 seconds";
-            if (context) {
-                context->deleteLater();
-            }
-            qCDebug(CLASS_LC) << "Context deleted";
-            if (zeroConfBrowser->browserExists()) {
-                zeroConfBrowser->stopBrowser();
-            }
-            qCDebug(CLASS_LC) << "Zeroconf browser stopped";
-            if (zeroConfBrowser) {
-                zeroConfBrowser->deleteLater();
-            }
-            qCDebug(CLASS_LC) << "Zeroconf browser deleted";
-        });
+    Entity *entity = qobject_cast<Entity *>(m_entities->get(entityId));
+    if (!entity || latency > ENTITY_COMMAND_MAX_WAIT) {
+        // the API command has expired, this one has been sent by the UI
+        return;
     }
+    m_entityCommandLatency[entityType + '.' + entity->getCommandName(command)].record(latency);
 }
 
-void YioAPI::onNewConnection() {
-    QWebSocket *socket = m_server->nextPendingConnection();
-
-    connect(socket, &QWebSocket::textMessageReceived, this, &YioAPI::processMessage);
-    connect(socket, &QWebSocket::disconnected, this, &YioAPI::onClientDisconnected);
-
-    // send message to client after connected to authenticate
-    QVariantMap map;
-    map.insert("type", "auth_required");
-    QJsonDocument doc     = QJsonDocument::fromVariant(map);
-    QString       message = doc.toJson(QJsonDocument::JsonFormat::Compact);
-
-    socket->sendTextMessage(message);
-    m_clients.insert(socket, false);
+void YioAPI::processRequest(ApiClient *apiClient, QWebSocket *client, const QVariant &request) {
+    if (request.type() == QVariant::List) {
+        // a plain array of requests is a sequential batch
+        QVariantMap batch;
+        batch.insert("type", "batch");
+        batch.insert("requests", request);
+        dispatch(apiClient, client, batch);
+    } else {
+        dispatch(apiClient, client, request.toMap());
+    }
 }
 
-void YioAPI::onClosed() {}
-
-void YioAPI::processMessage(QString message) {
-    QWebSocket *client = qobject_cast<QWebSocket *>(sender());
+void YioAPI::dispatch(ApiClient *apiClient, QWebSocket *client, const QVariantMap &map) {
+    bool    authenticated = apiClient->isAuthenticated();
+    QString type          = map.value("type").toString();
+    int     id            = map.value("id").toInt();
 
-    if (client) {
-        // qDebug(CLASS_LC) << message;
+    const QHash<QString, ApiCommand> &commands = apiCommands();
+    auto                              command  = commands.constFind(type);
 
-        // convert message to json
-        QJsonParseError parseerror;
-        QJsonDocument   doc = QJsonDocument::fromJson(message.toUtf8(), &parseerror);
-        if (parseerror.error != QJsonParseError::NoError) {
-            qCWarning(CLASS_LC) << "JSON error:" << parseerror.errorString();
-            return;
-        }
-
-        QVariantMap map  = doc.toVariant().toMap();
-        QString     type = map.value("type").toString();
-        int         id;
-
-        if (map.contains("id")) {
-            id = map.value("id").toInt();
-        }
-
-        if (type == "auth" && !m_clients[client]) {
-            /// Authentication
-            apiAuth(client, map);
-        } else if (m_clients[client]) {
-            if (type == "button") {
-                /// Button simulation through the api
-                apiSystemButton(id, map);
-            } else if (type == "reboot") {
-                /// Reboot
-                apiSystemReboot(client, id);
-            } else if (type == "shutdown") {
-                /// Shutdown
-                apiSystemShutdown(client, id);
-            } else if (type == "subscribe_events") {
-                /// Subscribe to events
-                apiSystemSubscribeToEvents(client, id);
-            } else if (type == "unsubscribe_events") {
-                /// Unsubscribe from events
-                apiSystemUnsubscribeFromEvents(client, id);
-            } else if (type == "get_config") {
-                /// Get config
-                apiGetConfig(client, id);
-            } else if (type == "set_config") {
-                /// Set config
-                apiSetConfig(client, id, map);
-            } else if (type == "discover_integrations") {
-                /// Discover integrations
-                apiIntegrationsDiscover(client, id);
-            } else if (type == "get_supported_integrations") {
-                /// Get supported integrations
-                apiIntegrationsGetSupported(client, id);
-            } else if (type == "get_loaded_integrations") {
-                /// Get loaded integrations
-                apiIntegrationsGetLoaded(client, id);
-            } else if (type == "get_integration_setup_data") {
-                /// Get data required to setup an integration
-                apiIntegrationGetData(client, id, map);
-            } else if (type == "add_integration") {
-                /// Add a new integration
-                apiIntegrationAdd(client, id, map);
-            } else if (type == "update_integration") {
-                /// Update an integration
-                apiIntegrationUpdate(client, id, map);
-            } else if (type == "remove_integration") {
-                /// Remove an integration
-                apiIntegrationRemove(client, id, map);
-            } else if (type == "get_supported_entities") {
-                /// Get supported entities
-                apiEntitiesGetSupported(client, id);
-            } else if (type == "get_loaded_entities") {
-                /// Get loaded entities
-                apiEntitiesGetLoaded(client, id);
-            } else if (type == "get_available_entities") {
-                /// Get available entities from integrations
-                apiEntitiesGetAvailable(client, id);
-            } else if (type == "add_entity") {
-                /// Get available entities from integrations
-                apiEntitiesAdd(client, id, map);
-            } else if (type == "update_entity") {
-                /// Get available entities from integrations
-                apiEntitiesUpdate(client, id, map);
-            } else if (type == "remove_entity") {
-                /// Get available entities from integrations
-                apiEntitiesRemove(client, id, map);
-            } else if (type == "get_all_profiles") {
-                /// Get all profiles
-                apiProfilesGetAll(client, id);
-            } else if (type == "set_profile") {
-                /// Set current profile
-                apiProfilesSet(client, id, map);
-            } else if (type == "add_profile") {
-                /// Add new profile
-                apiProfilesAdd(client, id, map);
-            } else if (type == "update_profile") {
-                /// Update a profile
-                apiProfilesUpdate(client, id, map);
-            } else if (type == "remove_profile") {
-                /// Remove a profile
-                apiProfilesRemove(client, id, map);
-            } else if (type == "get_all_pages") {
-                /// Get all pages
-                apiPagesGetAll(client, id);
-            } else if (type == "add_page") {
-                /// Add a page
-                apiPagesAdd(client, id, map);
-            } else if (type == "update_page") {
-                /// Update a page
-                apiPagesUpdate(client, id, map);
-            } else if (type == "remove_page") {
-                /// Remove a page
-                apiPagesRemove(client, id, map);
-            } else if (type == "get_all_groups") {
-                /// Get all groups
-                apiGroupsGetAll(client, id);
-            } else if (type == "add_group") {
-                /// Add a group
-                apiGroupsAdd(client, id, map);
-            } else if (type == "update_group") {
-                /// Update a group
-                apiGroupsUpdate(client, id, map);
-            } else if (type == "remove_group") {
-                /// Remove a group
-                apiGroupsRemove(client, id, map);
-            } else if (type == "get_languages") {
-                /// Get all languages
-                apiSettingsGetAllLanguages(client, id);
-            } else if (type == "set_language") {
-                /// Set a languages
-                apiSettingsSetLanguage(client, id, map);
-            } else if (type == "set_auto_brightness") {
-                /// Set auto brightness
-                apiSettingsSetAutoBrightness(client, id, map);
-            } else if (type == "set_dark_mode") {
-                /// Set dark mode
-                apiSettingsSetDarkMode(client, id, map);
-            }
+    if (!authenticated && (command == commands.constEnd() || command->auth != AuthLevel::Unauthenticated)) {
+        QVariantMap response;
+        qCWarning(CLASS_LC) << "Client not authenticated";
+        response.insert("type", "auth_error");
+        response.insert("message", "Please authenticate");
+        apiClient->send(response);
+        apiClient->close();
+        return;
+    }
 
-        } else {
+    if (command == commands.constEnd() || (authenticated && command->auth == AuthLevel::Unauthenticated)) {
+        qCDebug(CLASS_LC) << "Ignoring unsupported request:" << type;
+        m_unknownRequests++;
+        if (m_batch) {
+            // every request of a batch gets a response
             QVariantMap response;
-            qCWarning(CLASS_LC) << "Client not authenticated";
-            response.insert("type", "auth_error");
-            response.insert("message", "Please authenticate");
-            QJsonDocument json = QJsonDocument::fromVariant(response);
-            client->sendTextMessage(json.toJson(QJsonDocument::JsonFormat::Compact));
-            client->disconnect();
+            response.insert("message", QString("Unsupported request: %1").arg(type));
+            apiSendResponse(client, id, false, response);
         }
+        return;
     }
-}
 
-void YioAPI::onClientDisconnected() {
-    qCDebug(CLASS_LC) << "Client disconnected";
-    QWebSocket *client = qobject_cast<QWebSocket *>(sender());
-    if (client) {
-        client->close();
-        qCDebug(CLASS_LC) << "Client closed" << client;
-        m_clients.remove(client);
-        client->deleteLater();
-        qCDebug(CLASS_LC) << "Client removed";
+    // optimistic concurrency: reject the request if the configuration has been modified meanwhile
+    if (map.contains("if_revision") && map.value("if_revision").toULongLong() != m_config->revision()) {
+        QVariantMap response;
+        response.insert("message", "revision mismatch");
+        apiSendResponse(client, id, false, response);
+        return;
     }
-}
 
-void YioAPI::subscribeOnSignalEvent(const QString &event) {
-    qCDebug(CLASS_LC) << "Sending message to all subscribed clients";
+    QElapsedTimer timer;
+    timer.start();
 
-    for (int i = 0; i < m_subscribed_clients.length(); i++) {
-        QVariantMap response;
-        response.insert("event", event);
-        QJsonDocument json = QJsonDocument::fromVariant(response);
-        m_subscribed_clients[i]->sendTextMessage(json.toJson(QJsonDocument::JsonFormat::Compact));
+    command->handler(this, client, id, map);
+
+    // asynchronous requests only account for the synchronous part
+    m_commandLatency[command.key()].record(timer.nsecsElapsed() / 1000);
+}
+
+void YioAPI::onClientDisconnected(QWebSocket *client) {
+    ApiClient *apiClient = m_clients.take(client);
+    if (apiClient) {
+        m_events->removeClient(apiClient);
+        // deletes the socket as well
+        apiClient->deleteLater();
+        qCDebug(CLASS_LC) << "Client removed" << client;
     }
 }
 
@@ -751,22 +875,103 @@ void YioAPI::apiSendResponse(QWebSocket *client, const int &id, const bool &succ
     response.insert("id", id);
     response.insert("success", success);
     response.insert("type", "result");
+    response.insert("revision", m_config->revision());
 
-    QJsonDocument json = QJsonDocument::fromVariant(response);
-
-    if (client) {
-        if (m_clients.contains(client)) {
-            if (client->isValid()) {
-                client->sendTextMessage(json.toJson(QJsonDocument::JsonFormat::Compact));
-                qCDebug(CLASS_LC) << "Sent response to client" << client;
-            }
+    if (m_batch && m_batch->client == client) {
+        if (!success) {
+            m_batch->failed++;
+        }
+        if (!m_batch->stream) {
+            m_batch->responses.append(response);
+            return;
         }
     }
+
+    ApiClient *apiClient = m_clients.value(client);
+    if (apiClient && apiClient->isValid()) {
+        apiClient->send(response);
+        qCDebug(CLASS_LC) << "Sent response to client" << client;
+    }
     //    qCDebug(CLASS_LC) << "Response sent to client:" << client << "id:" << id << "response:" << response;
 }
 
+void YioAPI::apiSendResponse(QWebSocket *client, const int &id, const bool &success, QJsonObject response) {
+    if (m_batch && m_batch->client == client && !m_batch->stream) {
+        // collected responses are encoded together with the batch result
+        apiSendResponse(client, id, success, response.toVariantMap());
+        return;
+    }
+
+    response.insert("id", id);
+    response.insert("success", success);
+    response.insert("type", "result");
+    response.insert("revision", static_cast<qint64>(m_config->revision()));
+
+    if (m_batch && m_batch->client == client && !success) {
+        m_batch->failed++;
+    }
+
+    ApiClient *apiClient = m_clients.value(client);
+    if (apiClient && apiClient->isValid()) {
+        apiClient->send(response);
+        qCDebug(CLASS_LC) << "Sent response to client" << client;
+    }
+}
+
+void YioAPI::apiBatch(QWebSocket *client, const int &id, const QVariantMap &map) {
+    qCDebug(CLASS_LC) << "Request for batch" << client;
+    QVariantMap response;
+
+    if (m_batch) {
+        response.insert("message", "Nested batches are not supported");
+        apiSendResponse(client, id, false, response);
+        return;
+    }
+
+    QVariantList requests = map.value("requests").toList();
+    if (requests.size() > BATCH_MAX_REQUESTS) {
+        response.insert("message", QString("Too many requests, maximum: %1").arg(BATCH_MAX_REQUESTS));
+        apiSendResponse(client, id, false, response);
+        return;
+    }
+
+    // independent requests are all executed, otherwise the batch stops at the first failed request. The configuration
+    // writes of the requests are coalesced by the config writer.
+    bool  independent = map.value("independent", false).toBool();
+    Batch batch;
+    batch.client = client;
+    batch.stream = map.value("stream", false).toBool();
+
+    ApiClient *apiClient = m_clients.value(client);
+    m_batch              = &batch;
+
+    int executed = 0;
+    int failed   = 0;
+    for (const QVariant &request : requests) {
+        if (!independent && batch.failed > 0) {
+            QVariantMap skipped;
+            skipped.insert("message", "skipped");
+            apiSendResponse(client, request.toMap().value("id").toInt(), false, skipped);
+            continue;
+        }
+        dispatch(apiClient, client, request.toMap());
+        executed++;
+        failed = batch.failed;
+    }
+
+    m_batch = nullptr;
+
+    response.insert("executed", executed);
+    response.insert("failed", failed);
+    if (!batch.stream) {
+        response.insert("responses", batch.responses);
+    }
+    apiSendResponse(client, id, batch.failed == 0, response);
+}
+
 void YioAPI::apiAuth(QWebSocket *client, const QVariantMap &map) {
-    qCDebug(CLASS_LC) << "Client authenticating:" << m_clients[client];
+    ApiClient *apiClient = m_clients.value(client);
+    qCDebug(CLASS_LC) << "Client authenticating:" << client;
 
     QVariantMap response;
 
@@ -779,10 +984,13 @@ void YioAPI::apiAuth(QWebSocket *client, const QVariantMap &map) {
         if (map.value("token").toString() == m_token) {
             qDebug(CLASS_LC) << "Token OK";
             response.insert("type", "auth_ok");
-            QJsonDocument json = QJsonDocument::fromVariant(response);
-            client->sendTextMessage(json.toJson(QJsonDocument::JsonFormat::Compact));
+            apiClient->send(response);
 
-            m_clients[client] = true;
+            apiClient->setAuthenticated(true);
+            // encoding of all following messages, CBOR clients may also just send binary frames
+            if (map.value("encoding").toString() == "cbor") {
+                apiClient->setEncoding(ApiClient::Encoding::Cbor);
+            }
 
             qCDebug(CLASS_LC) << "Client connected:" << client;
 
@@ -790,20 +998,72 @@ void YioAPI::apiAuth(QWebSocket *client, const QVariantMap &map) {
             qCWarning(CLASS_LC) << "Token NOT OK";
             response.insert("type", "auth_error");
             response.insert("message", "Invalid token");
-            QJsonDocument json = QJsonDocument::fromVariant(response);
-            client->sendTextMessage(json.toJson(QJsonDocument::JsonFormat::Compact));
-            client->disconnect();
+            apiClient->send(response);
+            apiClient->close();
         }
     } else {
         qCWarning(CLASS_LC) << "No token";
         response.insert("type", "auth_error");
         response.insert("message", "Token needed");
-        QJsonDocument json = QJsonDocument::fromVariant(response);
-        client->sendTextMessage(json.toJson(QJsonDocument::JsonFormat::Compact));
-        client->disconnect();
+        apiClient->send(response);
+        apiClient->close();
     }
 }
 
+void YioAPI::apiGetStats(QWebSocket *client, const int &id, const QVariantMap &map) {
+    qCDebug(CLASS_LC) << "Request for get api stats" << client;
+
+    QVariantMap response;
+    QVariantMap commands;
+    for (auto iter = m_commandLatency.cbegin(); iter != m_commandLatency.cend(); ++iter) {
+        commands.insert(iter.key(), iter.value().toVariantMap());
+    }
+    response.insert("commands", commands);
+    response.insert("unknown_requests", m_unknownRequests);
+
+    QVariantMap entityCommands;
+    for (auto iter = m_entityCommandLatency.cbegin(); iter != m_entityCommandLatency.cend(); ++iter) {
+        entityCommands.insert(iter.key(), iter.value().toVariantMap());
+    }
+    response.insert("entity_commands", entityCommands);
+    QVariantList clients;
+    for (ApiClient *apiClient : qAsConst(m_clients)) {
+        clients.append(apiClient->statistics());
+    }
+    response.insert("clients", clients);
+    response.insert("events", m_events->statistics());
+    response.insert("dispatch_delay", m_dispatchDelay.toVariantMap());
+    response.insert("server", m_server->statistics());
+    response.insert("discovery", m_discovery->statistics());
+    response.insert("integration_threads", m_integrations->threadStatistics());
+    response.insert("reconnect", m_integrations->reconnectScheduler()->statistics());
+    response.insert("command_queues", m_integrations->commandStatistics());
+    response.insert("config_writer", m_config->getWriteStatistics());
+
+    FrameTimeMonitor *frameTime = FrameTimeMonitor::getInstance();
+    if (frameTime) {
+        response.insert("frame_time", frameTime->statistics());
+    }
+
+    // start a new measurement period, e.g. before an API load test
+    if (map.value("reset").toBool()) {
+        for (LatencyHistogram &histogram : m_commandLatency) {
+            histogram.reset();
+        }
+        for (LatencyHistogram &histogram : m_entityCommandLatency) {
+            histogram.reset();
+        }
+        m_dispatchDelay.reset();
+        m_integrations->reconnectScheduler()->resetStatistics();
+        m_integrations->resetCommandStatistics();
+        if (frameTime) {
+            frameTime->reset();
+        }
+    }
+
+    apiSendResponse(client, id, true, response);
+}
+
 void YioAPI::apiSystemButton(const int &id, const QVariantMap &map) {
     Q_UNUSED(id);
     QString buttonName   = map["name"].toString();
@@ -820,6 +1080,7 @@ void YioAPI::apiSystemButton(const int &id, const QVariantMap &map) {
 void YioAPI::apiSystemReboot(QWebSocket *client, const int &id) {
     Q_UNUSED(id);
     qCDebug(CLASS_LC) << "Request for reboot" << client;
+    m_config->flush();
     Launcher launcher;
     launcher.launch("reboot");
 }
@@ -830,68 +1091,138 @@ void YioAPI::apiSystemShutdown(QWebSocket *client, const int &id) {
     StandbyControl::getInstance()->shutdown();
 }
 
-void YioAPI::apiSystemSubscribeToEvents(QWebSocket *client, const int &id) {
+void YioAPI::apiSystemSubscribeToEvents(QWebSocket *client, const int &id, const QVariantMap &map) {
     qCDebug(CLASS_LC) << "Request for subscribe to events" << client;
+    ApiClient  *apiClient = m_clients.value(client);
     QVariantMap response;
 
-    if (m_subscribed_clients.contains(client)) {
-        apiSendResponse(client, id, false, response);
+    if (!map.contains("topics")) {
+        // former API: configuration change events only
+        if (m_events->isSubscribed(apiClient, ApiEventHub::TOPIC_CONFIG)) {
+            apiSendResponse(client, id, false, response);
+            return;
+        }
+        m_events->subscribe(apiClient, ApiEventHub::TOPIC_CONFIG, QVariantMap(), true);
+        apiSendResponse(client, id, true, response);
         return;
     }
 
-    // add client to the subscribed client list
-    m_subscribed_clients.append(client);
+    // topics: list of topic names or objects with the topic name and its filter
+    QVariantList topics = map.value("topics").toList();
+    for (const QVariant &item : topics) {
+        QVariantMap filter = item.toMap();
+        QString     topic  = filter.isEmpty() ? item.toString() : filter.value("topic").toString();
+        if (!ApiEventHub::topics().contains(topic)) {
+            response.insert("message", QString("Unsupported topic: %1").arg(topic));
+            apiSendResponse(client, id, false, response);
+            return;
+        }
+    }
+
+    for (const QVariant &item : topics) {
+        QVariantMap filter = item.toMap();
+        QString     topic  = filter.isEmpty() ? item.toString() : filter.value("topic").toString();
+        m_events->subscribe(apiClient, topic, filter);
+    }
+
+    response.insert("topics", m_events->subscriptions(apiClient));
+    response.insert("seq", m_events->sequence());
+    response.insert("stream", m_events->stream());
 
-    // connect to signals
-    m_context = new QObject(this);
+    if (!map.contains("resume_from")) {
+        apiSendResponse(client, id, true, response);
+        return;
+    }
 
-    QObject::connect(m_config, &Config::configChanged, m_context, [=]() { subscribeOnSignalEvent("config_changed"); });
-    QObject::connect(m_config, &Config::settingsChanged, m_context,
-                     [=]() { subscribeOnSignalEvent("settings_changed"); });
-    QObject::connect(m_config, &Config::profileIdChanged, m_context,
-                     [=]() { subscribeOnSignalEvent("profileId_changed"); });
-    QObject::connect(m_config, &Config::profileFavoritesChanged, m_context,
-                     [=]() { subscribeOnSignalEvent("profileFavorites_changed"); });
-    QObject::connect(m_config, &Config::profilesChanged, m_context,
-                     [=]() { subscribeOnSignalEvent("profiles_changed"); });
-    QObject::connect(m_config, &Config::uiConfigChanged, m_context,
-                     [=]() { subscribeOnSignalEvent("uiConfig_changed"); });
-    QObject::connect(m_config, &Config::pagesChanged, m_context, [=]() { subscribeOnSignalEvent("pages_changed"); });
-    QObject::connect(m_config, &Config::groupsChanged, m_context, [=]() { subscribeOnSignalEvent("groups_changed"); });
+    // reconnecting client: send the missed events after the response or request a new snapshot
+    quint64 resumeFrom = map.value("resume_from").toULongLong();
+    bool    resumable  = m_events->canReplay(resumeFrom);
+    if (map.value("stream").toString() != m_events->stream()) {
+        // the remote has been restarted meanwhile, or the sequence number can't be assigned to this stream
+        resumable = false;
+    }
+    response.insert("resync_required", !resumable);
 
+    // the missed events of these topics are lost, e.g. log messages have to be fetched from the logger, entity
+    // states with get_entity_states
+    QStringList notReplayed;
+    for (const QString &topic : ApiEventHub::topics()) {
+        if (!ApiEventHub::isReplayable(topic) && m_events->isSubscribed(apiClient, topic)) {
+            notReplayed.append(topic);
+        }
+    }
+    response.insert("not_replayed", notReplayed);
     apiSendResponse(client, id, true, response);
+
+    if (resumable) {
+        m_events->replay(apiClient, resumeFrom);
+    }
 }
 
-void YioAPI::apiSystemUnsubscribeFromEvents(QWebSocket *client, const int &id) {
+void YioAPI::apiSystemUnsubscribeFromEvents(QWebSocket *client, const int &id, const QVariantMap &map) {
     qCDebug(CLASS_LC) << "Request for unsubscribe from events" << client;
+    ApiClient  *apiClient = m_clients.value(client);
+    QVariantMap response;
+
+    bool removed = false;
+    if (map.contains("topics")) {
+        for (const QVariant &topic : map.value("topics").toList()) {
+            removed |= m_events->unsubscribe(apiClient, topic.toString());
+        }
+    } else {
+        removed = m_events->unsubscribe(apiClient);
+    }
+
+    response.insert("topics", m_events->subscriptions(apiClient));
+    apiSendResponse(client, id, removed, response);
+}
+
+void YioAPI::apiSubscribeEntities(QWebSocket *client, const int &id, const QVariantMap &map) {
+    qCDebug(CLASS_LC) << "Request for subscribe to entities" << client;
+    ApiClient  *apiClient = m_clients.value(client);
     QVariantMap response;
 
-    if (!m_subscribed_clients.contains(client)) {
+    int interval = map.value("interval", ENTITY_COALESCING_INTERVAL).toInt();
+    if (interval < 0 || interval > ENTITY_COALESCING_INTERVAL_MAX) {
+        response.insert("message", QString("Invalid interval: 0 - %1 ms").arg(ENTITY_COALESCING_INTERVAL_MAX));
         apiSendResponse(client, id, false, response);
         return;
     }
 
-    QObject::disconnect(m_context);
-    m_context->deleteLater();
-
-    for (int i = 0; i < m_subscribed_clients.length(); i++) {
-        if (m_subscribed_clients[i] == client) {
-            m_subscribed_clients.removeAt(i);
-            apiSendResponse(client, id, true, response);
-            return;
-        }
+    QStringList entityIds;
+    for (const QVariant &entityId : map.value("entity_ids").toList()) {
+        entityIds.append(entityId.toString());
     }
 
-    apiSendResponse(client, id, false, response);
+    // the response contains the current state, afterwards only the changed attributes are sent
+    response.insert("entities", m_events->watchEntities(apiClient, entityIds, interval));
+    response.insert("interval", interval);
+    apiSendResponse(client, id, true, response);
+}
+
+void YioAPI::apiUnsubscribeEntities(QWebSocket *client, const int &id) {
+    qCDebug(CLASS_LC) << "Request for unsubscribe from entities" << client;
+    ApiClient *apiClient = m_clients.value(client);
+    apiSendResponse(client, id, m_events->unwatchEntities(apiClient), QVariantMap());
 }
 
-void YioAPI::apiGetConfig(QWebSocket *client, const int &id) {
+void YioAPI::apiGetConfig(QWebSocket *client, const int &id, const QVariantMap &map) {
     qCDebug(CLASS_LC) << "Request for get config" << client;
 
     QVariantMap response;
     QVariantMap config = getConfig();
 
-    if (!config.isEmpty()) {
+    if (map.contains("path")) {
+        // only transfer the requested subtree
+        QString  path = map.value("path").toString();
+        bool     found;
+        QVariant value = ConfigUtil::getValueByPointer(config, path, &found);
+        response.insert("path", path);
+        if (found) {
+            response.insert("config", value);
+        }
+        apiSendResponse(client, id, found, response);
+    } else if (!config.isEmpty()) {
         response.insert("config", config);
         apiSendResponse(client, id, true, response);
     } else {
@@ -912,51 +1243,73 @@ void YioAPI::apiSetConfig(QWebSocket *client, const int &id, const QVariantMap &
     }
 }
 
-void YioAPI::apiIntegrationsDiscover(QWebSocket *client, const int &id) {
-    qCDebug(CLASS_LC) << "Request for discover integrations" << client;
+void YioAPI::apiPatchConfig(QWebSocket *client, const int &id, const QVariantMap &map) {
+    qCDebug(CLASS_LC) << "Request for patch config" << client;
+
+    QVariantMap response;
+    QVariant    config = getConfig();
+    QVariant    patch = map.value("patch");
+    QStringList changedPaths;
+    QString     error;
+    bool        success;
+
+    if (patch.type() == QVariant::List) {
+        // JSON Patch: RFC 6902
+        success = JsonPatch::apply(&config, patch.toList(), &changedPaths, &error);
+    } else if (patch.type() == QVariant::Map) {
+        // JSON Merge Patch: RFC 7396
+        success = JsonPatch::mergePatch(&config, patch, map.value("path").toString(), &changedPaths, &error);
+    } else {
+        success = false;
+        error = "patch must be a JSON Patch array or a JSON Merge Patch object";
+    }
 
-    QTimer * timeOutTimer = new QTimer();
-    QObject *context      = new QObject(this);
+    if (success && config.type() != QVariant::Map) {
+        success = false;
+        error = "configuration must be an object";
+    }
 
-    QObject::connect(this, &YioAPI::serviceDiscovered, context, [=](QVariantMap services) {
-        qCDebug(CLASS_LC) << "Service discovered";
-        QVariantMap response;
-        QVariantMap map;
+    if (success && !changedPaths.isEmpty() && !setConfig(config.toMap(), changedPaths)) {
+        success = false;
+        error = m_config->getError();
+    }
 
-        // let's go through the returned list of discovered integrations
-        QVariantMap::iterator i;
-        for (i = services.begin(); i != services.end(); i++) {
-            QString friendlyName = i.value().toMap().value("txt").toMap().value("FriendlyName").toString();
-            if (friendlyName.isEmpty()) {
-                friendlyName = i.value().toMap().value("name").toString();
-            }
-            map.insert("friendly_name", friendlyName);
-            map.insert("ip", i.value().toMap().value("ip").toString());
-            map.insert("type", m_integrations->getTypeByMdns(i.value().toMap().value("mdns").toString()));
-        }
+    if (success) {
+        response.insert("changed", changedPaths);
+    } else {
+        qCWarning(CLASS_LC) << "Patching config failed:" << error;
+        response.insert("message", error);
+    }
+    apiSendResponse(client, id, success, response);
+}
 
-        response.insert("discovered_integration", map);
-        apiSendResponse(client, id, true, response);
-    });
+void YioAPI::apiIntegrationsDiscover(QWebSocket *client, const int &id) {
+    qCDebug(CLASS_LC) << "Request for discover integrations" << client;
 
+    // make sure all plugin service types are browsed: a newly started browser reports with discovery events
     discoverNetworkServices();
 
-    // start a timeout timer if nothing is discovered
-    timeOutTimer->setSingleShot(true);
+    QVariantList integrations;
+    for (const QVariant &item : m_discovery->services()) {
+        QVariantMap service      = item.toMap();
+        QString     friendlyName = service.value("txt").toMap().value("FriendlyName").toString();
+        if (friendlyName.isEmpty()) {
+            friendlyName = service.value("name").toString();
+        }
 
-    connect(timeOutTimer, &QTimer::timeout, this, [=]() {
-        qCDebug(CLASS_LC) << "API Discovery timeout.";
-        QVariantMap response;
-        response.insert("message", "discovery_done");
-        qCDebug(CLASS_LC) << "API Discovery timeout, response created.";
-        apiSendResponse(client, id, true, response);
+        QVariantMap map;
+        map.insert("name", service.value("name"));
+        map.insert("friendly_name", friendlyName);
+        map.insert("ip", service.value("ip"));
+        map.insert("type", m_integrations->getTypeByMdns(service.value("mdns").toString()));
+        integrations.append(map);
+    }
 
-        if (context) {
-            context->deleteLater();
-        }
-        timeOutTimer->deleteLater();
-    });
-    timeOutTimer->start(10000);
+    // later changes are streamed to clients subscribed to the discovery topic
+    QVariantMap response;
+    response.insert("discovered_integrations", integrations);
+    response.insert("message", "discovery_done");
+    apiSendResponse(client, id, true, response);
 }
 
 void YioAPI::apiIntegrationsGetSupported(QWebSocket *client, const int &id) {
@@ -1034,7 +1387,6 @@ void YioAPI::apiIntegrationUpdate(QWebSocket *client, const int &id, const QVari
     QVariantMap response;
 
     if (updateIntegration(map.value("config").toMap())) {
-        response.insert("message", "Restart the remote to update the integration.");
         apiSendResponse(client, id, true, response);
     } else {
         apiSendResponse(client, id, false, response);
@@ -1084,32 +1436,44 @@ void YioAPI::apiEntitiesGetLoaded(QWebSocket *client, const int &id) {
 void YioAPI::apiEntitiesGetAvailable(QWebSocket *client, const int &id) {
     qCDebug(CLASS_LC) << "Request for get all available entities" << client;
 
-    QVariantMap      response;
-    QVariantList     availableEntities;
-    QList<QObject *> integrations = m_integrations->list();
+    QVariantMap                   response;
+    QList<IntegrationInterface *> integrations;
+    for (QObject *obj : m_integrations->list()) {
+        IntegrationInterface *ii = qobject_cast<IntegrationInterface *>(obj);
+        if (ii) {
+            integrations.append(ii);
+        }
+    }
 
     if (integrations.isEmpty()) {
         apiSendResponse(client, id, false, response);
         return;
     }
 
-    for (int i = 0; i < integrations.length(); i++) {
-        if (integrations[i]) {
-            IntegrationInterface *ii = qobject_cast<IntegrationInterface *>(integrations[i]);
-            if (ii) {
-                availableEntities.append(ii->getAllAvailableEntities());
-            }
-        }
-    }
-
-    if (availableEntities.isEmpty()) {
-        response.insert("available_entities", QVariantList());
-        apiSendResponse(client, id, true, response);
-        return;
+    // every integration is asked in its own thread, the response is sent when all of them replied
+    struct Request {
+        int          pending;
+        QVariantList availableEntities;
+    };
+    auto request     = QSharedPointer<Request>::create();
+    request->pending = integrations.length();
+
+    for (IntegrationInterface *ii : qAsConst(integrations)) {
+        IntegrationThreads::post(ii, [this, client, id, request](IntegrationInterface *integration) {
+            QVariantList entities = integration->getAllAvailableEntities();
+            QMetaObject::invokeMethod(this,
+                                      [this, client, id, request, entities]() {
+                                          request->availableEntities.append(entities);
+                                          if (--request->pending > 0) {
+                                              return;
+                                          }
+                                          QVariantMap response;
+                                          response.insert("available_entities", request->availableEntities);
+                                          apiSendResponse(client, id, true, response);
+                                      },
+                                      Qt::QueuedConnection);
+        });
     }
-
-    response.insert("available_entities", availableEntities);
-    apiSendResponse(client, id, true, response);
 }
 
 void YioAPI::apiEntitiesAdd(QWebSocket *client, const int &id, const QVariantMap &map) {
@@ -1149,6 +1513,190 @@ void YioAPI::apiEntitiesRemove(QWebSocket *client, const int &id, const QVariant
     }
 }
 
+void YioAPI::apiEntitiesAddBulk(QWebSocket *client, const int &id, const QVariantMap &map) {
+    QVariantList entities = map.value("entities").toList();
+    qCDebug(CLASS_LC) << "Request for add entities:" << entities.size() << client;
+
+    QVariantMap response;
+    QString     error;
+
+    bool success = addEntities(entities, &error);
+    if (!success) {
+        response.insert("message", error);
+    }
+    apiSendResponse(client, id, success, response);
+}
+
+void YioAPI::apiEntitiesUpdateBulk(QWebSocket *client, const int &id, const QVariantMap &map) {
+    QVariantList entities = map.value("entities").toList();
+    qCDebug(CLASS_LC) << "Request for update entities:" << entities.size() << client;
+
+    QVariantMap response;
+    QString     error;
+
+    bool success = updateEntities(entities, &error);
+    if (!success) {
+        response.insert("message", error);
+    }
+    apiSendResponse(client, id, success, response);
+}
+
+void YioAPI::apiEntitiesRemoveBulk(QWebSocket *client, const int &id, const QVariantMap &map) {
+    QStringList entityIds = map.value("entity_ids").toStringList();
+    qCDebug(CLASS_LC) << "Request for remove entities:" << entityIds.size() << client;
+
+    QVariantMap response;
+    QString     error;
+
+    bool success = removeEntities(entityIds, &error);
+    if (!success) {
+        response.insert("message", error);
+    }
+    apiSendResponse(client, id, success, response);
+}
+
+void YioAPI::apiEntityCommand(QWebSocket *client, const int &id, const QVariantMap &map) {
+    qCDebug(CLASS_LC) << "Request for entity command" << client;
+    QVariantMap response;
+
+    QString entityId = map.value("entity_id").toString();
+    Entity *entity   = qobject_cast<Entity *>(m_entities->get(entityId));
+    if (!entity) {
+        response.insert("message", QString("Entity not found: %1").arg(entityId));
+        apiSendResponse(client, id, false, response);
+        return;
+    }
+
+    // command by index or name, names are resolved once per entity type
+    QVariant command      = map.value("command");
+    int      commandIndex = -1;
+    if (command.type() == QVariant::String) {
+        QString key  = entity->type() + '/' + command.toString().toUpper();
+        auto    iter = m_commandIndexes.constFind(key);
+        if (iter == m_commandIndexes.constEnd()) {
+            iter = m_commandIndexes.insert(key, entity->getCommandIndex(command.toString()));
+        }
+        commandIndex = iter.value();
+    } else if (command.canConvert<int>()) {
+        commandIndex = command.toInt();
+    }
+
+    QString commandName = commandIndex < 0 ? QString() : entity->getCommandName(commandIndex);
+    if (commandName.isEmpty()) {
+        response.insert("message", QString("Unsupported command: %1").arg(command.toString()));
+        apiSendResponse(client, id, false, response);
+        return;
+    }
+
+    // commands are held by the queue while the integration is disconnected and sent after reconnecting
+    CommandQueue *queue = m_integrations->commandQueue(entity->integration());
+    if (!queue) {
+        response.insert("message", QString("Integration not loaded: %1").arg(entity->integration()));
+        apiSendResponse(client, id, false, response);
+        return;
+    }
+    // the latency is recorded when the queue hands the command over to the integration, a coalesced value replaces
+    // the pending one
+    m_pendingEntityCommands.insert(qMakePair(entityId, commandIndex), m_requestReceived);
+
+    // the same rate limit and coalescing as commands from the UI
+    entity->command(commandIndex, map.value("param"));
+
+    response.insert("entity_id", entityId);
+    response.insert("command", commandName);
+    response.insert("queued", true);
+    apiSendResponse(client, id, true, response);
+}
+
+void YioAPI::apiEntityStates(QWebSocket *client, const int &id, const QVariantMap &map) {
+    qCDebug(CLASS_LC) << "Request for entity states" << client;
+
+    int limit = map.value("limit", ENTITY_STATES_LIMIT).toInt();
+    if (limit < 1 || limit > ENTITY_STATES_LIMIT_MAX) {
+        QVariantMap response;
+        response.insert("message", QString("Invalid limit: 1 - %1").arg(ENTITY_STATES_LIMIT_MAX));
+        apiSendResponse(client, id, false, response);
+        return;
+    }
+
+    // filters accept a single value or a list of values
+    QStringList types        = map.value("type").toStringList();
+    QStringList areas        = map.value("area").toStringList();
+    QStringList integrations = map.value("integration").toStringList();
+    QStringList fields       = map.value("fields").toStringList();
+    QString     cursor       = map.value("cursor").toString();
+
+    // general entity properties are included if requested or without projection
+    auto wanted = [&fields](const QString &field) { return fields.isEmpty() || fields.contains(field); };
+
+    // projected attribute indexes per entity type
+    QHash<QString, QVector<int>> projections;
+
+    // The page is built straight from the entity objects in entity_id order, the cursor is the last returned entity_id.
+    const QMap<QString, Entity *> &entities = m_entities->entities();
+
+    auto       iter = cursor.isEmpty() ? entities.constBegin() : entities.upperBound(cursor);
+    QJsonArray states;
+    QString    nextCursor;
+    for (; iter != entities.constEnd(); ++iter) {
+        Entity *entity = iter.value();
+        if ((!types.isEmpty() && !types.contains(entity->type())) ||
+            (!areas.isEmpty() && !areas.contains(entity->area())) ||
+            (!integrations.isEmpty() && !integrations.contains(entity->integration()))) {
+            continue;
+        }
+        if (states.size() == limit) {
+            // at least one more matching entity
+            nextCursor = states.last().toObject().value("entity_id").toString();
+            break;
+        }
+
+        auto projection = projections.constFind(entity->type());
+        if (projection == projections.constEnd()) {
+            QVector<int> indexes;
+            for (const QString &field : fields.isEmpty() ? entity->allAttributes() : fields) {
+                int attrIndex = entity->getAttrIndex(field);
+                if (attrIndex >= 0) {
+                    indexes.append(attrIndex);
+                }
+            }
+            projection = projections.insert(entity->type(), indexes);
+        }
+
+        QJsonObject state;
+        state.insert("entity_id", iter.key());
+        if (wanted("type")) {
+            state.insert("type", entity->type());
+        }
+        if (wanted("friendly_name")) {
+            state.insert("friendly_name", entity->friendly_name());
+        }
+        if (wanted("area")) {
+            state.insert("area", entity->area());
+        }
+        if (wanted("integration")) {
+            state.insert("integration", entity->integration());
+        }
+        if (wanted("connected")) {
+            state.insert("connected", entity->connected());
+        }
+        if (wanted("favorite")) {
+            state.insert("favorite", entity->favorite());
+        }
+        for (int attrIndex : projection.value()) {
+            state.insert(entity->getAttrName(attrIndex).toLower(),
+                         QJsonValue::fromVariant(entity->getAttrValue(attrIndex)));
+        }
+        states.append(state);
+    }
+
+    QJsonObject response;
+    response.insert("entities", states);
+    response.insert("count", states.size());
+    response.insert("next_cursor", nextCursor.isEmpty() ? QJsonValue() : QJsonValue(nextCursor));
+    apiSendResponse(client, id, true, response);
+}
+
 void YioAPI::apiProfilesGetAll(QWebSocket *client, const int &id) {
     qCDebug(CLASS_LC) << "Request for get all profiles" << client;
 
@@ -1237,9 +1785,15 @@ void YioAPI::apiProfilesRemove(QWebSocket *client, const int &id, const QVariant
     }
 
     if (success) {
+        // selected profile and profiles are written at once
+        m_config->beginTransaction();
         m_config->setProfileId(profiles.lastKey());
         m_config->setProfiles(profiles);
-        apiSendResponse(client, id, true, response);
+        success = m_config->commitTransaction();
+        if (!success) {
+            response.insert("message", m_config->getError());
+        }
+        apiSendResponse(client, id, success, response);
     } else {
         apiSendResponse(client, id, false, response);
     }
@@ -1298,6 +1852,9 @@ void YioAPI::apiPagesRemove(QWebSocket *client, const int &id, const QVariantMap
 
     QVariantMap response;
 
+    // profiles and pages are written at once
+    m_config->beginTransaction();
+
     // remove the page from the profiles
     QVariantMap profiles = m_config->getProfiles();
 
@@ -1330,6 +1887,13 @@ void YioAPI::apiPagesRemove(QWebSocket *client, const int &id, const QVariantMap
         }
     }
 
+    if (!success) {
+        m_config->rollbackTransaction();
+    } else if (!m_config->commitTransaction()) {
+        success = false;
+        response.insert("message", m_config->getError());
+    }
+
     if (success) {
         apiSendResponse(client, id, true, response);
     } else {
@@ -22,15 +22,23 @@
 #pragma once
 
 #include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QHash>
 #include <QObject>
+#include <QPair>
 #include <QQmlApplicationEngine>
+#include <QThread>
 #include <QtWebSockets/QWebSocket>
-#include <QtWebSockets/QWebSocketServer>
 
 #include "../qtzeroconf/qzeroconf.h"
+#include "apiclient.h"
+#include "apieventhub.h"
+#include "apiserver.h"
 #include "config.h"
 #include "entities/entities.h"
 #include "integrations/integrations.h"
+#include "latencyhistogram.h"
+#include "networkdiscovery.h"
 #include "yio-interface/yioapiinterface.h"
 
 class YioAPI : public YioAPIInterface {
@@ -54,11 +62,36 @@ class YioAPI : public YioAPIInterface {
     // CONFIG MANIPULATION METHODS
     QVariantMap getConfig() override;
     bool        setConfig(QVariantMap config);
+    /**
+     * @brief setConfig Sets a partially modified configuration. Only the changed subtrees are validated.
+     * @param changedPaths JSON pointers of the modified subtrees
+     */
+    bool setConfig(const QVariantMap& config, const QStringList& changedPaths);
 
     bool addEntity(QVariantMap entity) override;
     bool updatEntity(QVariantMap entity) override;
     bool removeEntity(QString entityId) override;
 
+    /**
+     * @brief addEntities Adds multiple entities with one configuration write. Either all or no entities are added.
+     * @param entities Entity configurations including the entity type
+     * @param error Returns the error message
+     */
+    bool addEntities(const QVariantList& entities, QString* error = nullptr);
+    /**
+     * @brief updateEntities Updates multiple entities with one configuration write. The entity objects are updated in
+     * place, they are only recreated if the entity type or integration changed.
+     * @param entities Entity configurations including the entity type
+     * @param error Returns the error message
+     */
+    bool updateEntities(const QVariantList& entities, QString* error = nullptr);
+    /**
+     * @brief removeEntities Removes multiple entities, including their group and favorite references, with one
+     * configuration write.
+     * @param error Returns the error message
+     */
+    bool removeEntities(const QStringList& entityIds, QString* error = nullptr);
+
     Q_INVOKABLE bool addIntegration(QVariantMap integration);
     bool             updateIntegration(QVariantMap integration);
     bool             removeIntegration(QString integrationId);
@@ -81,18 +114,18 @@ class YioAPI : public YioAPIInterface {
     void buttonReleased(QString button);
 
  public slots:  // NOLINT open issue: https://github.com/cpplint/cpplint/pull/99
-    void onClosed();
-    void onNewConnection();
-    void processMessage(QString message);
-    void onClientDisconnected();
+    void onClientConnected(QWebSocket* client, ApiClient* apiClient);
+    void onClientDisconnected(QWebSocket* client);
+    void onRequestReceived(QWebSocket* client, const QVariant& request, qint64 received);
+    void onEntityCommandHandedOver(const QString& entityType, const QString& entityId, int command);
 
  private:
-    QWebSocketServer*       m_server;
-    QMap<QWebSocket*, bool> m_clients;  // websocket client, true if authentication was successful
+    // the transport layer runs in its own thread, the sockets are only used as client handles in the GUI thread
+    QThread                        m_serverThread;
+    ApiServer*                     m_server;
+    QHash<QWebSocket*, ApiClient*> m_clients;
 
-    QList<QWebSocket*> m_subscribed_clients;
-    QObject*           m_context;
-    void               subscribeOnSignalEvent(const QString& event);
+    ApiEventHub* m_events;
 
     bool m_running = false;
 
@@ -107,29 +140,94 @@ class YioAPI : public YioAPIInterface {
         "1\xFA\x90\xED\x16\xBB";
     QString m_hostname;
 
-    QZeroConf  m_zeroConf;
-    QZeroConf* m_zeroConfBrowser;
+    QZeroConf m_zeroConf;
 
-    QStringList m_discoverableServices;
-    QString     m_prevIp;
+    // long-lived mDNS browsers with the cache of discovered services
+    NetworkDiscovery* m_discovery;
 
     Entities*     m_entities;
     Integrations* m_integrations;
     Config*       m_config;
 
+    bool checkEntityConfig(const QString& entityType, const QVariantMap& entity, QString* error);
+
+    // API COMMAND DISPATCHER
+    enum class AuthLevel {
+        Unauthenticated,  // only accepted before authentication
+        Authenticated
+    };
+    typedef void (*ApiHandler)(YioAPI* api, QWebSocket* client, int id, const QVariantMap& map);
+    struct ApiCommand {
+        AuthLevel  auth;
+        ApiHandler handler;
+    };
+
+    /**
+     * @brief Returns the registered API commands. The table is built once on first use.
+     */
+    static const QHash<QString, ApiCommand>& apiCommands();
+
+    // adapters for the different API call signatures
+    template <void (YioAPI::*F)(QWebSocket*, const int&)>
+    static void apiCall(YioAPI* api, QWebSocket* client, int id, const QVariantMap&) {
+        (api->*F)(client, id);
+    }
+    template <void (YioAPI::*F)(QWebSocket*, const int&, const QVariantMap&)>
+    static void apiCall(YioAPI* api, QWebSocket* client, int id, const QVariantMap& map) {
+        (api->*F)(client, id, map);
+    }
+
+    /**
+     * @brief Executes a decoded request map or a batch of requests.
+     */
+    void processRequest(ApiClient* apiClient, QWebSocket* client, const QVariant& request);
+
+    /**
+     * @brief Executes a single request: checks authentication, dispatches the command and records its latency.
+     */
+    void dispatch(ApiClient* apiClient, QWebSocket* client, const QVariantMap& map);
+
+    // responses of the batch in progress
+    struct Batch {
+        QWebSocket*  client = nullptr;
+        bool         stream = false;  // send responses immediately instead of collecting them
+        int          failed = 0;
+        QVariantList responses;
+    };
+    Batch* m_batch = nullptr;
+
+    // request latency per command
+    QHash<QString, LatencyHistogram> m_commandLatency;
+    quint32                          m_unknownRequests = 0;
+    LatencyHistogram                 m_dispatchDelay;  // from receiving a request until dispatched in the GUI thread
+
+    // entity commands: latency from receiving the request until handed over to the integration per entity type and
+    // command, resolved command indexes per entity type and command name
+    QElapsedTimer                      m_clock;
+    qint64                             m_requestReceived = 0;  // nanoseconds of m_clock
+    QHash<QString, LatencyHistogram>   m_entityCommandLatency;
+    QHash<QString, int>                m_commandIndexes;
+    QHash<QPair<QString, int>, qint64> m_pendingEntityCommands;  // entity id, command -> request received
+
     // API CALLS
     void apiSendResponse(QWebSocket* client, const int& id, const bool& success, QVariantMap response);
+    void apiSendResponse(QWebSocket* client, const int& id, const bool& success, QJsonObject response);
 
     void apiAuth(QWebSocket* client, const QVariantMap& map);
+    void apiBatch(QWebSocket* client, const int& id, const QVariantMap& map);
 
     void apiSystemButton(const int& id, const QVariantMap& map);
     void apiSystemReboot(QWebSocket* client, const int& id);
     void apiSystemShutdown(QWebSocket* client, const int& id);
-    void apiSystemSubscribeToEvents(QWebSocket* client, const int& id);
-    void apiSystemUnsubscribeFromEvents(QWebSocket* client, const int& id);
+    void apiSystemSubscribeToEvents(QWebSocket* client, const int& id, const QVariantMap& map);
+    void apiSystemUnsubscribeFromEvents(QWebSocket* client, const int& id, const QVariantMap& map);
+    void apiSubscribeEntities(QWebSocket* client, const int& id, const QVariantMap& map);
+    void apiUnsubscribeEntities(QWebSocket* client, const int& id);
+    void apiGetStats(QWebSocket* client, const int& id, const QVariantMap& map);
 
-    void apiGetConfig(QWebSocket* client, const int& id);
+    void apiGetConfig(QWebSocket* client, const int& id, const QVariantMap& map);
     void apiSetConfig(QWebSocket* client, const int& id, const QVariantMap& map);
+    void apiPatchConfig(QWebSocket* client, const int& id, const QVariantMap& map);
 
     void apiIntegrationsDiscover(QWebSocket* client, const int& id);
     void apiIntegrationsGetSupported(QWebSocket* client, const int& id);
@@ -145,6 +243,11 @@ class YioAPI : public YioAPIInterface {
     void apiEntitiesAdd(QWebSocket* client, const int& id, const QVariantMap& map);
     void apiEntitiesUpdate(QWebSocket* client, const int& id, const QVariantMap& map);
     void apiEntitiesRemove(QWebSocket* client, const int& id, const QVariantMap& map);
+    void apiEntitiesAddBulk(QWebSocket* client, const int& id, const QVariantMap& map);
+    void apiEntitiesUpdateBulk(QWebSocket* client, const int& id, const QVariantMap& map);
+    void apiEntitiesRemoveBulk(QWebSocket* client, const int& id, const QVariantMap& map);
+    void apiEntityCommand(QWebSocket* client, const int& id, const QVariantMap& map);
+    void apiEntityStates(QWebSocket* client, const int& id, const QVariantMap& map);
 
     void apiProfilesGetAll(QWebSocket* client, const int& id);
     void apiProfilesSet(QWebSocket* client, const int& id, const QVariantMap& map);